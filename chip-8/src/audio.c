@@ -0,0 +1,255 @@
+#include <SDL.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "chip8.h"
+
+#define PATTERN_BITS (AUDIO_PATTERN_SIZE * 8)
+
+void init_audio(audio_t *audio) {
+    memset(audio->params, 0, sizeof(audio->params));
+    memset(&audio->published, 0, sizeof(audio->published));
+    init_triple_buffer(&audio->slots);
+    SDL_AtomicSet(&audio->event_head, 0);
+    SDL_AtomicSet(&audio->event_tail, 0);
+    audio->device = 0;
+    audio->sample_rate = AUDIO_SAMPLE_RATE;
+    audio->wanted = false;
+    audio->opener = NULL;
+    audio->clock = 0.0;
+    audio->ratio = 1.0;
+    audio->queued = false;
+    SDL_AtomicSet(&audio->played, 0);
+    audio->phase = 0.0;
+    audio->playing = false;
+    audio->rendered = 0.0;
+    audio->offset = 0.0;
+}
+
+// Synthesize samples from the newest tone. Runs on the audio thread.
+static void audio_callback(void *userdata, Uint8 *stream, int len) {
+    audio_t *audio = userdata;
+
+    swap_front(&audio->slots);
+    render_audio(audio, (int16_t *)stream, len / (int)sizeof(int16_t));
+}
+
+// Start the audio subsystem and the device. Only the device's own rate is
+// used, converted by SDL if need be, so the emulator's view of time never
+// changes under it.
+bool open_audio(audio_t *audio) {
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0) {
+        printf("Could not initialize SDL audio: %s\n", SDL_GetError());
+        return false;
+    }
+
+    SDL_AudioSpec want;
+    SDL_AudioSpec have;
+    memset(&want, 0, sizeof(want));
+    want.freq = AUDIO_SAMPLE_RATE;
+    want.format = AUDIO_S16SYS;
+    want.channels = 1;
+    want.samples = AUDIO_BUFFER_SAMPLES;
+    want.callback = audio_callback;
+    want.userdata = audio;
+
+    audio->device = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0);
+    if (audio->device == 0) {
+        printf("Could not initialize audio device: %s\n", SDL_GetError());
+        return false;
+    }
+
+    SDL_PauseAudioDevice(audio->device, 0);
+    return true;
+}
+
+static int audio_opener(void *data) {
+    return open_audio(data) ? 0 : -1;
+}
+
+// Open the device the first time it is wanted, on a thread of its own so a
+// slow audio server never holds up emulation. Sound queued meanwhile plays
+// once the device is up. Without threads it is opened right away.
+void start_audio(audio_t *audio) {
+    if (!audio->wanted)
+        return;
+
+    audio->wanted = false;
+    audio->opener = SDL_CreateThread(audio_opener, "audio opener", audio);
+    if (!audio->opener)
+        open_audio(audio);
+}
+
+void close_audio(audio_t *audio) {
+    if (audio->opener) {
+        SDL_WaitThread(audio->opener, NULL);
+        audio->opener = NULL;
+    }
+    if (audio->device != 0) {
+        SDL_CloseAudioDevice(audio->device);
+        audio->device = 0;
+    }
+}
+
+// Hand a tone to the callback. Called every frame, but only changes are
+// published, so a steady tone costs a single compare.
+void update_audio(audio_t *audio, const audio_params_t *params) {
+    if (memcmp(&audio->published, params, sizeof(*params)) == 0)
+        return;
+
+    audio->params[audio->slots.back] = *params;
+    swap_back(&audio->slots);
+    audio->published = *params;
+}
+
+// Samples of emulation in a frame, stretched by rate control
+static double frame_samples(const audio_t *audio) {
+    return audio->ratio * audio->sample_rate / 60.0;
+}
+
+// Start or stop the tone, `when` being how far into the current frame, from
+// 0 to 1. Only changes are queued. When the queue is full the change is
+// dropped, and a later call with the same state queues it again.
+void queue_sound(audio_t *audio, bool playing, double when) {
+    if (playing == audio->queued)
+        return;
+
+    int head = SDL_AtomicGet(&audio->event_head);
+    int next = (head + 1) % AUDIO_EVENTS;
+    if (next == SDL_AtomicGet(&audio->event_tail))
+        return;
+
+    audio->events[head] = (audio_event_t){
+        audio->clock + when * frame_samples(audio), playing};
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&audio->event_head, next);
+    audio->queued = playing;
+}
+
+// Move on to the next frame's worth of samples
+void advance_audio(audio_t *audio) {
+    audio->clock += frame_samples(audio);
+}
+
+// Event times wrap at 32 bits where they are shared with the callback
+static uint32_t wrap_time(double time) {
+    return (uint32_t)(int64_t)time;
+}
+
+// Samples emulated that the device has yet to play
+int audio_lead(audio_t *audio) {
+    uint32_t played = (uint32_t)SDL_AtomicGet(&audio->played);
+    return (int32_t)(wrap_time(audio->clock) - played);
+}
+
+// Pace frames by the audio device instead of the clock: wait while more
+// than the target lead is queued. The samples per frame are nudged by up
+// to AUDIO_MAX_SKEW towards the target, so the lead settles there instead
+// of swinging around it, and audio and emulation never drift apart.
+void pace_audio(audio_t *audio) {
+    int lead = audio_lead(audio);
+    if (lead < 0) {
+        // The device ran dry; carry on from where it is
+        audio->clock = floor(audio->clock) - lead;
+        lead = 0;
+    }
+
+    double error = (double)(AUDIO_SYNC_LEAD - lead) / AUDIO_SYNC_LEAD;
+    if (error > 1.0)
+        error = 1.0;
+    if (error < -1.0)
+        error = -1.0;
+    audio->ratio = 1.0 + AUDIO_MAX_SKEW * error;
+
+    // A stalled device must not hang the emulator
+    for (int ms = 0; ms < 100 && audio_lead(audio) > AUDIO_SYNC_LEAD; ms++) {
+        SDL_Delay(1);
+    }
+}
+
+// Fill `samples` with the front tone while the sound timer runs: the
+// pattern is played as a loop of one bit samples at
+// 4000 * 2^((pitch - 64) / 48) bits per second.
+static void render_tone(audio_t *audio, const audio_params_t *params,
+                        int16_t *samples, int count) {
+    if (!audio->playing) {
+        memset(samples, 0, count * sizeof(*samples));
+        return;
+    }
+
+    double rate = 4000.0 * pow(2.0, (params->pitch - 64) / 48.0);
+    double step = rate / audio->sample_rate;
+    double phase = audio->phase;
+
+    for (int i = 0; i < count; i++) {
+        int bit = (int)phase;
+        bool high = params->pattern[bit >> 3] & (0x80 >> (bit & 7));
+        samples[i] = high ? AUDIO_VOLUME : -AUDIO_VOLUME;
+
+        phase += step;
+        if (phase >= PATTERN_BITS)
+            phase -= PATTERN_BITS;
+    }
+
+    audio->phase = phase;
+}
+
+// Fill `samples`, starting and stopping the tone on the sample each queued
+// change falls on. Emulation time maps onto output time through `offset`,
+// which is set again whenever a change comes in too late to be played on
+// time, or so early that emulation must have jumped ahead.
+void render_audio(audio_t *audio, int16_t *samples, int count) {
+    const audio_params_t *params = &audio->params[audio->slots.front];
+
+    int i = 0;
+    while (i < count) {
+        int tail = SDL_AtomicGet(&audio->event_tail);
+        bool pending = tail != SDL_AtomicGet(&audio->event_head);
+        int end = count;
+
+        if (pending) {
+            SDL_MemoryBarrierAcquire();
+            const audio_event_t *event = &audio->events[tail];
+            double now = audio->rendered + i;
+            double at = event->time + audio->offset;
+            if (at < now || at > now + AUDIO_MAX_LEAD) {
+                audio->offset = now - event->time;
+                at = now;
+            }
+            if (at < audio->rendered + count) {
+                end = (int)ceil(at - audio->rendered);
+            } else {
+                pending = false;  // Falls in a later buffer
+            }
+        }
+
+        render_tone(audio, params, &samples[i], end - i);
+        i = end;
+
+        if (pending) {
+            audio->playing = audio->events[tail].playing;
+            SDL_AtomicSet(&audio->event_tail, (tail + 1) % AUDIO_EVENTS);
+        }
+    }
+
+    audio->rendered += count;
+    SDL_AtomicSet(&audio->played,
+                  (int)wrap_time(audio->rendered - audio->offset));
+}
+
+// Render the samples of the frames emulated since the last call, as the
+// callback would, for runs without a device. Returns how many were
+// rendered, at most `max`.
+int render_frame_audio(audio_t *audio, int16_t *samples, int max) {
+    int count = (int)(floor(audio->clock + 0.5) - audio->rendered);
+    if (count > max)
+        count = max;
+    if (count <= 0)
+        return 0;
+
+    swap_front(&audio->slots);
+    render_audio(audio, samples, count);
+    return count;
+}
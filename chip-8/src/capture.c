@@ -0,0 +1,253 @@
+#include "capture.h"
+
+#include <SDL.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// RGB and video range luma by palette index, matching the renderer
+static const uint8_t capture_rgb[1 << DISPLAY_PLANES][3] = {
+    {0x00, 0x00, 0x00},
+    {0xFF, 0xFF, 0xFF},
+    {0xAA, 0xAA, 0xAA},
+    {0x55, 0x55, 0x55},
+};
+static const uint8_t capture_luma[1 << DISPLAY_PLANES] = {16, 235, 162, 89};
+
+typedef enum { CAPTURE_PPM, CAPTURE_Y4M } capture_format_t;
+
+// One display image in the packed row format of the display
+typedef struct {
+    uint32_t number;
+    uint16_t width;
+    uint16_t height;
+    display_plane_t planes[DISPLAY_PLANES];
+} packed_frame_t;
+
+struct capture {
+    capture_format_t format;
+    char *path;     // Output file, or printf pattern for image sequences
+    FILE *stream;   // Open y4m stream
+    int every;      // Capture every Nth frame
+    bool lossless;  // Wait for queue space instead of dropping frames
+    int width;      // Output resolution; smaller frames are scaled up
+    int height;
+
+    uint32_t frame;    // Emulated frames seen so far
+    uint32_t dropped;  // Frames dropped because the queue was full
+
+    // Single-producer/single-consumer ring of packed frames
+    packed_frame_t queue[CAPTURE_QUEUE_LENGTH];
+    SDL_atomic_t head;  // Next slot written by the emulator
+    SDL_atomic_t tail;  // Next slot read by the writer
+    SDL_sem *queued;    // Posted for every queued frame
+    SDL_sem *freed;     // Posted for every written frame
+    SDL_atomic_t running;
+    SDL_Thread *writer;
+};
+
+static bool ends_with(const char *s, const char *suffix) {
+    size_t s_len = strlen(s);
+    size_t suffix_len = strlen(suffix);
+    return s_len >= suffix_len &&
+           strcmp(s + s_len - suffix_len, suffix) == 0;
+}
+
+// An image sequence path is used as a printf format, so it must hold exactly
+// one integer conversion like %d or %05d and no other conversions. "%%" is
+// still allowed for a literal percent sign.
+static bool is_frame_pattern(const char *path) {
+    int conversions = 0;
+    for (const char *p = strchr(path, '%'); p; p = strchr(p, '%')) {
+        p++;
+        if (*p == '%') {
+            p++;
+            continue;
+        }
+        if (*p == '0')
+            p++;
+        while (*p >= '0' && *p <= '9')
+            p++;
+        if (*p != 'd')
+            return false;
+        conversions++;
+    }
+    return conversions == 1;
+}
+
+// Palette index of an output pixel, scaling lores frames up to the output
+// size
+static int color_at(const struct capture *capture,
+                    const packed_frame_t *frame, int x, int y) {
+    return get_color(frame->planes, x * frame->width / capture->width,
+                     y * frame->height / capture->height);
+}
+
+static bool write_ppm(struct capture *capture, const packed_frame_t *frame) {
+    char name[FILENAME_MAX];
+    snprintf(name, sizeof(name), capture->path, (int)frame->number);
+
+    FILE *fp = fopen(name, "wb");
+    if (!fp)
+        return false;
+
+    uint8_t rgb[DISPLAY_MAX_WIDTH * DISPLAY_MAX_HEIGHT * 3];
+    uint8_t *out = rgb;
+    for (int y = 0; y < capture->height; y++) {
+        for (int x = 0; x < capture->width; x++) {
+            memcpy(out, capture_rgb[color_at(capture, frame, x, y)], 3);
+            out += 3;
+        }
+    }
+
+    fprintf(fp, "P6\n%d %d\n255\n", capture->width, capture->height);
+    bool written = fwrite(rgb, out - rgb, 1, fp) == 1;
+    return fclose(fp) == 0 && written;
+}
+
+static bool write_y4m(struct capture *capture, const packed_frame_t *frame) {
+    uint8_t luma[DISPLAY_MAX_WIDTH * DISPLAY_MAX_HEIGHT];
+    uint8_t *out = luma;
+    for (int y = 0; y < capture->height; y++) {
+        for (int x = 0; x < capture->width; x++) {
+            *out++ = capture_luma[color_at(capture, frame, x, y)];
+        }
+    }
+
+    fputs("FRAME\n", capture->stream);
+    return fwrite(luma, out - luma, 1, capture->stream) == 1;
+}
+
+static int writer_loop(void *arg) {
+    struct capture *capture = (struct capture *)arg;
+    bool failed = false;
+
+    for (;;) {
+        SDL_SemWait(capture->queued);
+
+        int tail = SDL_AtomicGet(&capture->tail);
+        if (tail == SDL_AtomicGet(&capture->head)) {
+            // Woken with an empty queue only when closing
+            if (!SDL_AtomicGet(&capture->running))
+                break;
+            continue;
+        }
+
+        const packed_frame_t *frame =
+            &capture->queue[tail % CAPTURE_QUEUE_LENGTH];
+        bool written = capture->format == CAPTURE_Y4M
+                           ? write_y4m(capture, frame)
+                           : write_ppm(capture, frame);
+        if (!written && !failed) {
+            fprintf(stderr, "Error: Could not write capture frame %u\n",
+                    (unsigned)frame->number);
+            failed = true;
+        }
+
+        SDL_AtomicSet(&capture->tail, tail + 1);
+        SDL_SemPost(capture->freed);
+    }
+
+    return failed ? -1 : 0;
+}
+
+capture_t *capture_open(const char *path, int every, bool lossless,
+                        int width, int height) {
+    struct capture *capture = calloc(1, sizeof(*capture));
+    if (!capture)
+        return NULL;
+
+    capture->every = every > 0 ? every : 1;
+    capture->lossless = lossless;
+    capture->width = width;
+    capture->height = height;
+    capture->path = malloc(strlen(path) + 1);
+    if (!capture->path) {
+        capture_close(capture);
+        return NULL;
+    }
+    strcpy(capture->path, path);
+
+    if (ends_with(path, ".y4m")) {
+        capture->format = CAPTURE_Y4M;
+        capture->stream = fopen(path, "wb");
+        if (!capture->stream) {
+            fprintf(stderr, "Error: Could not open capture file\n");
+            capture_close(capture);
+            return NULL;
+        }
+        fprintf(capture->stream, "YUV4MPEG2 W%d H%d F60:%d Ip A1:1 Cmono\n",
+                capture->width, capture->height, capture->every);
+    } else if (is_frame_pattern(path)) {
+        capture->format = CAPTURE_PPM;
+    } else {
+        fprintf(stderr, "Error: Capture path must end in .y4m or contain a "
+                        "frame number pattern like frame_%%05d.ppm\n");
+        capture_close(capture);
+        return NULL;
+    }
+
+    capture->queued = SDL_CreateSemaphore(0);
+    capture->freed = SDL_CreateSemaphore(CAPTURE_QUEUE_LENGTH);
+    SDL_AtomicSet(&capture->running, 1);
+    if (capture->queued && capture->freed)
+        capture->writer = SDL_CreateThread(writer_loop, "capture", capture);
+    if (!capture->writer) {
+        fprintf(stderr, "Error: Could not start capture thread: %s\n",
+                SDL_GetError());
+        capture_close(capture);
+        return NULL;
+    }
+
+    return capture;
+}
+
+// Called once per emulated frame with the display as it was presented
+void capture_frame(capture_t *capture, const chip8_t *chip8) {
+    uint32_t number = capture->frame++;
+    if (number % capture->every != 0)
+        return;
+
+    // Reserve a slot; interactive runs drop the frame rather than wait
+    if (capture->lossless) {
+        SDL_SemWait(capture->freed);
+    } else if (SDL_SemTryWait(capture->freed) != 0) {
+        capture->dropped++;
+        return;
+    }
+
+    int head = SDL_AtomicGet(&capture->head);
+    packed_frame_t *frame = &capture->queue[head % CAPTURE_QUEUE_LENGTH];
+    frame->number = number / capture->every;
+    frame->width = chip8->display_width;
+    frame->height = chip8->display_height;
+    memcpy(frame->planes, chip8->display, sizeof(chip8->display));
+
+    SDL_AtomicSet(&capture->head, head + 1);
+    SDL_SemPost(capture->queued);
+}
+
+// Flushes all queued frames before returning
+void capture_close(capture_t *capture) {
+    if (capture->writer) {
+        SDL_AtomicSet(&capture->running, 0);
+        SDL_SemPost(capture->queued);
+        SDL_WaitThread(capture->writer, NULL);
+    }
+
+    if (capture->dropped > 0) {
+        fprintf(stderr, "Capture dropped %u of %u frames\n",
+                (unsigned)capture->dropped, (unsigned)capture->frame);
+    }
+
+    if (capture->stream)
+        fclose(capture->stream);
+    if (capture->queued)
+        SDL_DestroySemaphore(capture->queued);
+    if (capture->freed)
+        SDL_DestroySemaphore(capture->freed);
+    free(capture->path);
+    free(capture);
+}
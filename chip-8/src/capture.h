@@ -0,0 +1,21 @@
+/*
+Frame capture to a PPM image sequence or a raw y4m stream. Frames are packed
+and queued for a background writer thread so disk I/O never stalls the
+emulator.
+*/
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdbool.h>
+
+#include "chip8.h"
+
+#define CAPTURE_QUEUE_LENGTH 64  // Packed frames buffered for the writer
+
+capture_t *capture_open(const char *path, int every, bool lossless,
+                        int width, int height);
+void capture_frame(capture_t *capture, const chip8_t *chip8);
+void capture_close(capture_t *capture);
+
+#endif /* CAPTURE_H */
@@ -1,10 +1,17 @@
 #include "chip8.h"
 
-#include <SDL_mixer.h>
+#include "capture.h"
+#include "movie.h"
+#include "netplay.h"
+#include "rewind.h"
+#include "saveslots.h"
+#include "wav.h"
+
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 unsigned char chip8_fontset[FONT_MEMORY_SIZE] = {
@@ -26,6 +33,36 @@ unsigned char chip8_fontset[FONT_MEMORY_SIZE] = {
     0xF0, 0x80, 0xF0, 0x80, 0x80   // F
 };
 
+// SUPER-CHIP 8x10 digits, with the XO-CHIP additions for A-F
+unsigned char chip8_big_fontset[BIG_FONT_MEMORY_SIZE] = {
+    0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF,  // 0
+    0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF,  // 1
+    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF,  // 2
+    0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF,  // 3
+    0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03,  // 4
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF,  // 5
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF,  // 6
+    0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18,  // 7
+    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF,  // 8
+    0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF,  // 9
+    0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3,  // A
+    0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC,  // B
+    0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C,  // C
+    0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC,  // D
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF,  // E
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0   // F
+};
+
+// COSMAC VIP hex keypad laid out on the left of a QWERTY keyboard:
+//   1 2 3 C      1 2 3 4
+//   4 5 6 D      Q W E R
+//   7 8 9 E      A S D F
+//   A 0 B F      Z X C V
+static const SDL_Keycode default_keymap[16] = {
+    SDLK_x, SDLK_1, SDLK_2, SDLK_3, SDLK_q, SDLK_w, SDLK_e, SDLK_a,
+    SDLK_s, SDLK_d, SDLK_z, SDLK_c, SDLK_4, SDLK_r, SDLK_f, SDLK_v,
+};
+
 void initialize(chip8_t *chip8) {
     // Registers
     chip8->pc = 0x200;
@@ -33,49 +70,76 @@ void initialize(chip8_t *chip8) {
     chip8->idx = 0x0;
     chip8->sp = 0x0;
 
-    // V-Registers, stack, memory, keypad
+    // V-Registers, stack, memory, keypad, RPL flags
     memset(chip8->V, 0, sizeof(chip8->V));
     memset(chip8->stack, 0, sizeof(chip8->stack));
     memset(chip8->memory, 0, sizeof(chip8->memory));
     memset(chip8->keypad, false, sizeof(chip8->keypad));
+    memset(chip8->rpl, 0, sizeof(chip8->rpl));
 
     // Graphics
-    memset(chip8->display, 0, sizeof(chip8->display));
+    set_resolution(chip8, false);
     memset(&chip8->sdl, 0, sizeof(chip8->sdl));
+    memcpy(chip8->sdl.keymap, default_keymap, sizeof(default_keymap));
+
+    // Sound; the default pattern is a square wave
+    init_audio(&chip8->sdl.audio);
+    for (int i = 0; i < AUDIO_PATTERN_SIZE; i++) {
+        chip8->pattern[i] = 0xF0;
+    }
+    chip8->pitch = AUDIO_DEFAULT_PITCH;
 
-    // Load fontset into memory
+    // Timers
+    chip8->delay_timer = 0;
+    chip8->sound_timer = 0;
+    chip8->sound_edge_count = 0;
+
+    // Load fontsets into memory
     for (int i = 0; i < FONT_MEMORY_SIZE; i++) {
         chip8->memory[FONT_START + i] = chip8_fontset[i];
     }
+    for (int i = 0; i < BIG_FONT_MEMORY_SIZE; i++) {
+        chip8->memory[BIG_FONT_START + i] = chip8_big_fontset[i];
+    }
 
     // Set initial state
     chip8->state = RUNNING;
     chip8->draw = false;
+    chip8->planes = 0x1;
+    chip8->ipf = INSTRUCTIONS_PER_FRAME;
+    set_profile(chip8, PROFILE_VIP);
 
     // Seed random number generator
-    srand(time(NULL));
+    seed_rng(chip8, (uint32_t)time(NULL));
+
+    // Nothing has been seen by a consumer of dirty pages yet
+    mark_all_dirty(chip8);
 }
 
-bool read_rom(uint8_t *buffer, const char *rom_path) {
+// Returns the size of the ROM, or 0 if it could not be loaded
+size_t read_rom(uint8_t *buffer, const char *rom_path) {
     FILE *rom = fopen(rom_path, "rb");
     if (!rom) {
         fprintf(stderr, "Unable to open rom\n");
-        return false;
+        return 0;
     }
 
     long rom_size = get_rom_size(rom);
     if (rom_size > MAX_ROM_SIZE) {
         fprintf(stderr, "Error: Rom size too large\n");
-        return false;
+        fclose(rom);
+        return 0;
     }
 
     // Read ROM into buffer
-    if (fread(buffer, 1, rom_size, rom) == 0) {
+    size_t read = fread(buffer, 1, rom_size, rom);
+    fclose(rom);
+    if (read == 0) {
         fprintf(stderr, "Error: Could not load ROM into memory\n");
-        return false;
+        return 0;
     }
 
-    return true;
+    return read;
 }
 
 long get_rom_size(FILE *fp) {
@@ -86,374 +150,492 @@ long get_rom_size(FILE *fp) {
 }
 
 bool setup_sdl(sdl_t *sdl) {
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) == -1) {
+    if (SDL_Init(SDL_INIT_VIDEO) == -1) {
         printf("Could not initialize SDL: %s\n", SDL_GetError());
         return false;
     }
 
+    // Scaling is done by the renderer, so the window can be any size
+    int scale = sdl->scale > 0 ? sdl->scale : WINDOW_SCALE;
     sdl->window = SDL_CreateWindow("CHIP-8 Emulator", WINDOW_X, WINDOW_Y,
-                                   DISPLAY_WIDTH * WINDOW_SCALE,
-                                   DISPLAY_HEIGHT * WINDOW_SCALE, 0);
+                                   LORES_WIDTH * scale,
+                                   LORES_HEIGHT * scale,
+                                   SDL_WINDOW_RESIZABLE);
     if (sdl->window == NULL) {
         printf("Could not initialize SDL_Window: %s\n", SDL_GetError());
         return false;
     }
+    SDL_SetWindowMinimumSize(sdl->window, LORES_WIDTH, LORES_HEIGHT);
 
-    sdl->renderer =
-        SDL_CreateRenderer(sdl->window, -1, SDL_RENDERER_ACCELERATED);
-    if (sdl->renderer == NULL) {
-        printf("Could not initialize SDL_Renderer: %s\n", SDL_GetError());
+    // The renderer belongs to this thread, along with the window and events
+    if (!open_display(sdl))
         return false;
-    }
 
 #ifndef UNIT_TEST
-    // Initialize playback audio device
-    if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 1, 2048) == -1) {
-        printf("Could not initialize audio device: %s\n", Mix_GetError());
-        return false;
+    // Samples are generated on the audio thread, which is only started once
+    // the sound timer first runs. Most ROMs are silent for a while, and
+    // opening a device can take long.
+    sdl->audio.wanted = true;
+#endif
+
+    return true;
+}
+
+void set_profile(chip8_t *chip8, profile_t profile) {
+    chip8->profile = profile;
+
+    // Only the VIP waits for vblank after drawing
+    chip8->quirks.display_wait = profile == PROFILE_VIP;
+}
+
+// The generator is part of the emulation state, so runs can be replayed
+void seed_rng(chip8_t *chip8, uint32_t seed) {
+    chip8->rng = seed ? seed : 1;  // xorshift never leaves 0
+}
+
+static uint8_t next_random(chip8_t *chip8) {
+    uint32_t x = chip8->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    chip8->rng = x;
+    return x >> 24;
+}
+
+// Switch between the 64x32 and SUPER-CHIP 128x64 modes, clearing the screen
+void set_resolution(chip8_t *chip8, bool hires) {
+    chip8->hires = hires;
+    chip8->display_width = hires ? HIRES_WIDTH : LORES_WIDTH;
+    chip8->display_height = hires ? HIRES_HEIGHT : LORES_HEIGHT;
+    memset(chip8->display, 0, sizeof(chip8->display));
+    chip8->draw = true;
+}
+
+// The one path for stores into memory, so written pages are known
+void write_memory(chip8_t *chip8, uint16_t address, uint8_t value) {
+    int page = address / MEMORY_PAGE_SIZE;
+    chip8->memory[address] = value;
+    for (int user = 0; user < DIRTY_USERS; user++) {
+        chip8->dirty[user][page / 64] |= (uint64_t)1 << (page % 64);
     }
+}
 
-    // Load beep sound
-    sdl->sound = Mix_LoadWAV(SOUND_PATH);
-    if (sdl->sound == NULL) {
-        printf("Could not load sound file: %s\n", SDL_GetError());
-        return false;
+bool is_page_dirty(const chip8_t *chip8, dirty_user_t user, int page) {
+    return (chip8->dirty[user][page / 64] >> (page % 64)) & 1;
+}
+
+// For changes made to memory as a whole, such as loading a state
+void mark_all_dirty(chip8_t *chip8) {
+    memset(chip8->dirty, 0xFF, sizeof(chip8->dirty));
+}
+
+void clear_dirty_pages(chip8_t *chip8, dirty_user_t user) {
+    memset(chip8->dirty[user], 0, sizeof(chip8->dirty[user]));
+}
+
+bool get_pixel(const display_row_t *rows, int x, int y) {
+    return (rows[y][x / 64] >> (63 - x % 64)) & 1;
+}
+
+// Palette index of a pixel, one bit per plane
+int get_color(const display_plane_t *planes, int x, int y) {
+    int color = 0;
+    for (int plane = 0; plane < DISPLAY_PLANES; plane++) {
+        color |= get_pixel(planes[plane], x, y) << plane;
     }
-#endif
+    return color;
+}
 
-    return true;
+// Clear the selected planes
+static void clear_display(chip8_t *chip8) {
+    for (int plane = 0; plane < DISPLAY_PLANES; plane++) {
+        if (chip8->planes & (1 << plane))
+            memset(chip8->display[plane], 0, sizeof(display_plane_t));
+    }
+    chip8->draw = true;
 }
 
-void emulate_cycle(chip8_t *chip8) {
-    // Fetch opcode
-    chip8->opcode =
-        chip8->memory[chip8->pc] << 8 | chip8->memory[chip8->pc + 1];
-
-    // Increment program counter to next instruction
-    chip8->pc += 2;
-
-    uint16_t X = (chip8->opcode & 0x0F00) >> 8;
-    uint16_t Y = (chip8->opcode & 0x00F0) >> 4;
-
-    uint32_t N = chip8->opcode & 0x000F;
-    uint32_t NN = chip8->opcode & 0x00FF;
-    uint32_t NNN = chip8->opcode & 0x0FFF;
-
-    bool key_pressed = false;
-    uint8_t n = 0;
-    uint8_t random_num = 0;
-
-    // Decode and execute opcode
-    switch (chip8->opcode & 0xF000) {
-        case 0x0000:
-            switch (chip8->opcode & 0x000F) {
-                case 0x0000:  // 00E0; Clears the screen.
-                    memset(chip8->display, 0, sizeof(chip8->display));
-                    break;
-                case 0x000E:  // 00EE: Returns from a subroutine.
-                    chip8->sp--;
-                    chip8->pc = chip8->stack[chip8->sp];
-                    break;
-                default: break;
-            }
-            break;
-        case 0x1000:  // 1NNN; Jumps to address NNN.
-            chip8->pc = NNN;
-            break;
-        case 0x2000:  // 2NNN; Calls subroutine at NNN.
-            chip8->stack[chip8->sp] = chip8->pc;
-            chip8->sp++;
-            chip8->pc = NNN;
-            break;
-        case 0x3000:  // 3XNN; Skips the next instruction if VX equals NN.
-            if (chip8->V[X] == NN)
-                chip8->pc += 2;
-            break;
-        case 0x4000:  // 4XNN; Skips the next instruction if VX does not equal
-                      // NN.
-            if (chip8->V[X] != NN)
-                chip8->pc += 2;
-            break;
-        case 0x5000:  // 5XY0; Skips the next instruction if VX equals VY.
-            if (chip8->V[X] == chip8->V[Y])
-                chip8->pc += 2;
-            break;
-        case 0x6000:  // 6XNN; Sets VX to NN.
-            chip8->V[X] = NN;
-            break;
-        case 0x7000:  // 7XNN; Adds NN to VX.
-            chip8->V[X] += NN;
-            break;
-        case 0x8000:
-            switch (chip8->opcode & 0x000F) {
-                case 0x0000:  // 8XY0; Sets VX to the value of VY.
-                    chip8->V[X] = chip8->V[Y];
-                    break;
-                case 0x0001:  // 8XY1; Sets VX to VX or VY.
-                    chip8->V[X] |= chip8->V[Y];
-                    break;
-                case 0x0002:  // 8XY2; Sets VX to VX and VY.
-                    chip8->V[X] &= chip8->V[Y];
-                    break;
-                case 0x0003:  // 8XY3; Sets VX to VX xor VY.
-                    chip8->V[X] ^= chip8->V[Y];
-                    break;
-                case 0x0004:  // 8XY4; Adds VY to VX. VF is set to 1 when
-                              // there's an overflow, and to 0 when there is
-                              // not.
-                    chip8->V[0xF] = (chip8->V[X] + chip8->V[Y]) > 0xFF;
-                    chip8->V[X] += chip8->V[Y];
-                    break;
-                case 0x0005:  // 8XY5; VY is subtracted from VX. VF is set to 0
-                              // when there's an underflow, and 1 when there is
-                              // not.
-                    chip8->V[0xF] = chip8->V[X] < chip8->V[Y];
-                    chip8->V[X] -= chip8->V[Y];
-                    break;
-                case 0x0006:  // 8XY6; Shifts VX to the right by 1, then stores
-                              // the least significant bit of VX prior to the
-                              // shift into VF.
-                    chip8->V[0xF] = chip8->V[X] & 0x0001;
-                    chip8->V[X] >>= 1;
-                    break;
-                case 0x0007:  // 8XY7; Sets VX to VY minus VX. VF is set to 0
-                              // when there's an underflow, and 1 when there is
-                              // not.
-                    chip8->V[0xF] = chip8->V[Y] < chip8->V[X];
-                    chip8->V[X] = chip8->V[Y] - chip8->V[X];
-                    break;
-                case 0x000E:  // 8XYE; Shifts VX to the left by 1, then sets VF
-                              // to 1 if the most significant bit of VX prior to
-                              // that shift was set, or to 0 if it was unset.
-                    chip8->V[0xF] = (chip8->V[X] & 0x80) >> 7;
-                    chip8->V[X] <<= 1;
-                    break;
-                default: break;
+// Scroll distances are given in hires pixels. SUPER-CHIP 1.1 halves them in
+// lores mode since the HP48 scrolls its doubled lores pixels by whole screen
+// pixels; later interpreters scroll whole lores pixels instead.
+static int scroll_distance(const chip8_t *chip8, int pixels, bool half) {
+    return half && !chip8->hires ? pixels / 2 : pixels;
+}
+
+// 00CN and 00DN; whole rows of the selected planes are moved at once
+static void scroll_vertical(chip8_t *chip8, int rows, bool down) {
+    int kept = chip8->display_height - rows;
+
+    for (int plane = 0; plane < DISPLAY_PLANES; plane++) {
+        if (!(chip8->planes & (1 << plane)))
+            continue;
+
+        display_row_t *display = chip8->display[plane];
+        if (down) {
+            memmove(&display[rows], &display[0], kept * sizeof(display_row_t));
+            memset(&display[0], 0, rows * sizeof(display_row_t));
+        } else {
+            memmove(&display[0], &display[rows], kept * sizeof(display_row_t));
+            memset(&display[kept], 0, rows * sizeof(display_row_t));
+        }
+    }
+    chip8->draw = true;
+}
+
+// 00FB; each row is shifted as one wide integer
+static void scroll_right(chip8_t *chip8, int shift) {
+
+    for (int plane = 0; plane < DISPLAY_PLANES; plane++) {
+        if (!(chip8->planes & (1 << plane)))
+            continue;
+
+        for (int y = 0; y < chip8->display_height; y++) {
+            uint64_t *row = chip8->display[plane][y];
+            for (int w = DISPLAY_ROW_WORDS - 1; w > 0; w--) {
+                row[w] = (row[w] >> shift) | (row[w - 1] << (64 - shift));
             }
-            break;
-        case 0x9000:  // 9XY0; Skips the next instruction if VX does not equal
-                      // VY.
-            if (chip8->V[X] != chip8->V[Y])
-                chip8->pc += 2;
-            break;
-        case 0xA000:  // ANNN; Sets I to the address NNN.
-            chip8->idx = NNN;
-            break;
-        case 0xB000:  // BNNN; Jumps to the address NNN plus V0.
-            chip8->pc = chip8->V[0x0] + NNN;
-            break;
-        case 0xC000:  // CXNN; Sets VX to the result of a bitwise AND operation
-                      // on a random number and NN.
-            random_num = rand() % 256;  // Range: [0, 255]
-            chip8->V[X] = random_num & NN;
-            break;
-        case 0xD000:  // DXYN; Draws a sprite at coordinate (VX, VY) that has a
-                      // width of 8 pixels and a height of N pixels.
-
-            // Initialize carry flag
-            chip8->V[0xF] = false;
-            chip8->draw = true;
-
-            // Loop through each row of the sprite
-            for (uint32_t i = 0; i < N; i++) {
-                // Get row (byte)
-                uint8_t sprite_row = chip8->memory[chip8->idx + i];
-
-                // For each bit in row (starting from the leftmost bit), XOR
-                // sprite pixel with display pixel
-                for (int j = 0; j <= 7; j++) {
-                    uint8_t current_bit_position = 1 << (7 - j);
-                    uint8_t current_bit = sprite_row & current_bit_position;
-
-                    bool sprite_pixel = (bool)current_bit;
-
-                    uint8_t display_x = chip8->V[X] + j;
-                    uint8_t display_y = chip8->V[Y] + i;
-                    uint16_t display_pixel_index =
-                        (DISPLAY_WIDTH * display_y) + display_x;
-                    bool *display_pixel = &chip8->display[display_pixel_index];
-
-                    // Set carry flag if current display pixel will be unset
-                    if (*display_pixel && sprite_pixel) {
-                        chip8->V[0xF] = true;
-                    }
-
-                    *display_pixel ^= sprite_pixel;
-                }
+            row[0] >>= shift;
+
+            // Pixels shifted past a lores row must not reappear in hires
+            if (!chip8->hires)
+                memset(&row[1], 0, sizeof(display_row_t) - sizeof(row[0]));
+        }
+    }
+    chip8->draw = true;
+}
+
+// 00FC
+static void scroll_left(chip8_t *chip8, int shift) {
+
+    for (int plane = 0; plane < DISPLAY_PLANES; plane++) {
+        if (!(chip8->planes & (1 << plane)))
+            continue;
+
+        for (int y = 0; y < chip8->display_height; y++) {
+            uint64_t *row = chip8->display[plane][y];
+            for (int w = 0; w < DISPLAY_ROW_WORDS - 1; w++) {
+                row[w] = (row[w] << shift) | (row[w + 1] >> (64 - shift));
             }
+            row[DISPLAY_ROW_WORDS - 1] <<= shift;
+        }
+    }
+    chip8->draw = true;
+}
+
+// XOR a sprite into the selected planes a packed row at a time. The sprite
+// starts at (x, y) wrapped onto the screen and is clipped at the right and
+// bottom edges, or wraps around them when `clip` is false. 16 pixel wide
+// sprites take two bytes per row, and with two planes selected the second
+// plane's sprite data follows the first's.
+//
+// All edge handling is settled before the loop: the row count is clipped
+// once, rows wrap with a mask (screen sizes are powers of two) and
+// bits past the right edge go through a mask that drops or wraps them, so
+// the blit itself has no bounds branches.
+static void draw_sprite(chip8_t *chip8, uint8_t x, uint8_t y, int height,
+                        bool wide, bool clip) {
+    int words = chip8->display_width / 64;
+    int row_mask = chip8->display_height - 1;
+    x &= chip8->display_width - 1;
+    y &= row_mask;
+
+    // Placement is shared by every plane. Wrapped bits spill into word 0.
+    int word = x / 64;
+    int shift = x % 64;
+    int next = word + 1 < words ? word + 1 : 0;
+    uint64_t spill_mask = clip && next == 0 ? 0 : ~(uint64_t)0;
+    int rows = height;
+    if (clip && rows > chip8->display_height - y)
+        rows = chip8->display_height - y;
+
+    int row_bytes = wide ? 2 : 1;
+    uint8_t wide_mask = wide ? 0xFF : 0x00;
+    uint16_t address = chip8->idx;
+    uint64_t collision = 0;
+
+    for (int plane = 0; plane < DISPLAY_PLANES; plane++) {
+        if (!(chip8->planes & (1 << plane)))
+            continue;
+
+        for (int i = 0; i < rows; i++) {
+            // Sprite row left aligned in a word, then moved to column x
+            uint16_t at = address + i * row_bytes;
+            uint8_t low = chip8->memory[(uint16_t)(at + 1)] & wide_mask;
+            uint64_t bits = (uint64_t)chip8->memory[at] << 56 |
+                            (uint64_t)low << 48;
+
+            uint64_t *row = chip8->display[plane][(y + i) & row_mask];
+            uint64_t left = bits >> shift;
+            uint64_t right = ((bits << 1) << (63 - shift)) & spill_mask;
+
+            // With one word per row, left and right never overlap
+            collision |= row[word] & left;
+            row[word] ^= left;
+            collision |= row[next] & right;
+            row[next] ^= right;
+        }
+
+        address += height * row_bytes;
+    }
+
+    chip8->V[0xF] = collision != 0;
+    chip8->draw = true;
+}
+
+// Skip the next instruction, which on XO-CHIP may be the 4 byte F000 NNNN
+static void skip_instruction(chip8_t *chip8, bool xochip) {
+    if (xochip && chip8->memory[chip8->pc] == 0xF0 &&
+        chip8->memory[(uint16_t)(chip8->pc + 1)] == 0x00) {
+        chip8->pc += 4;
+    } else {
+        chip8->pc += 2;
+    }
+}
+
+// Note the sound timer starting or stopping on this cycle. Past the limit,
+// the state at the end of the frame still comes through.
+static void add_sound_edge(chip8_t *chip8, bool playing) {
+    if (chip8->sound_edge_count < SOUND_EDGES) {
+        chip8->sound_edges[chip8->sound_edge_count++] =
+            (sound_edge_t){chip8->frame_cycle, playing};
+    }
+}
+
+// One interpreter per profile, each compiled with its quirks as constants
+#define VARIANT vip
+#define SCHIP false
+#define XOCHIP false
+#define SHIFT_VX false
+#define MEMORY_INCREMENT true
+#define JUMP_VX false
+#define CLIP true
+#define HALF_SCROLL false
+#define NARROW_DXY0 false
+#include "interpreter.inc"
+
+#define VARIANT schip_legacy
+#define SCHIP true
+#define XOCHIP false
+#define SHIFT_VX true
+#define MEMORY_INCREMENT false
+#define JUMP_VX true
+#define CLIP true
+#define HALF_SCROLL true
+#define NARROW_DXY0 true
+#include "interpreter.inc"
+
+#define VARIANT schip_modern
+#define SCHIP true
+#define XOCHIP false
+#define SHIFT_VX true
+#define MEMORY_INCREMENT false
+#define JUMP_VX true
+#define CLIP true
+#define HALF_SCROLL false
+#define NARROW_DXY0 false
+#include "interpreter.inc"
+
+#define VARIANT xochip
+#define SCHIP true
+#define XOCHIP true
+#define SHIFT_VX false
+#define MEMORY_INCREMENT true
+#define JUMP_VX false
+#define CLIP false
+#define HALF_SCROLL false
+#define NARROW_DXY0 false
+#include "interpreter.inc"
+
+typedef struct {
+    void (*cycle)(chip8_t *chip8);
+    void (*frame)(chip8_t *chip8);
+} interpreter_t;
+
+static const interpreter_t interpreters[PROFILE_COUNT] = {
+    [PROFILE_VIP] = {cycle_vip, frame_vip},
+    [PROFILE_SCHIP_LEGACY] = {cycle_schip_legacy, frame_schip_legacy},
+    [PROFILE_SCHIP_MODERN] = {cycle_schip_modern, frame_schip_modern},
+    [PROFILE_XOCHIP] = {cycle_xochip, frame_xochip},
+};
+
+// The variant is picked once per frame, never per instruction
+void emulate_frame(chip8_t *chip8) {
+    interpreters[chip8->profile].frame(chip8);
+}
+
+void emulate_cycle(chip8_t *chip8) {
+    interpreters[chip8->profile].cycle(chip8);
+}
+
+// Index of the CHIP-8 key bound to a keyboard key, or -1
+static int find_key(const sdl_t *sdl, SDL_Keycode sym) {
+    for (int i = 0; i < 16; i++) {
+        if (sdl->keymap[i] == sym)
+            return i;
+    }
+    return -1;
+}
+
+#define SLOT_SAVE 0x100  // Quick-save slot action saves rather than loads
+
+// Load a quick-save slot, or save it
+static void use_slot(chip8_t *chip8, int slot, bool save) {
+    if (save) {
+        if (slots_save(chip8->sdl.slots, slot, chip8))
+            printf("Saved slot %d\n", slot + 1);
+    } else if (slots_load(chip8->sdl.slots, slot, chip8)) {
+        printf("Loaded slot %d\n", slot + 1);
+    }
+}
+
+// Hold or release a CHIP-8 key. Only the event loop writes the keys.
+static void set_input_key(sdl_t *sdl, int key, bool held) {
+    int keys = SDL_AtomicGet(&sdl->input_keys);
+    keys = held ? keys | 1 << key : keys & ~(1 << key);
+    SDL_AtomicSet(&sdl->input_keys, keys);
+}
+
+// Turn an event into input for the emulator, or redraw after a resize. Runs
+// on the main thread, which owns the renderer, and touches nothing the
+// emulator owns.
+void handle_event(sdl_t *sdl, const SDL_Event *event) {
+    int key;
+    switch (event->type) {
+        case SDL_QUIT: SDL_AtomicSet(&sdl->input_quit, 1); break;
+        case SDL_WINDOWEVENT:
+            if (event->window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
+                resize_display(sdl);
             break;
-        case 0xE000:
-            switch (chip8->opcode & 0x00F0) {
-                case 0x0090:  // EX9E; Skips the next instruction if the key
-                              // stored in VX is pressed.
-                    if (chip8->keypad[chip8->V[X]])
-                        chip8->pc += 2;
-                    break;
-                case 0x00A0:  // EXA1; Skips the next instruction if the key
-                              // stored in VX is not pressed.
-                    if (!chip8->keypad[chip8->V[X]])
-                        chip8->pc += 2;
-                    break;
-                default: break;
+        case SDL_RENDER_TARGETS_RESET: reset_display(sdl); break;
+        case SDL_KEYDOWN:
+            if (event->key.keysym.sym == SDLK_ESCAPE)
+                SDL_AtomicSet(&sdl->input_quit, 1);
+            if (event->key.keysym.sym == SDLK_BACKSPACE)
+                SDL_AtomicSet(&sdl->input_rewind, sdl->rewind != NULL);
+            if (sdl->slots && event->key.keysym.sym >= SDLK_F1 &&
+                event->key.keysym.sym <= SDLK_F10) {
+                int slot = event->key.keysym.sym - SDLK_F1;
+                bool save = event->key.keysym.mod & KMOD_SHIFT;
+                SDL_AtomicSet(&sdl->input_slot,
+                              1 + slot + (save ? SLOT_SAVE : 0));
             }
+            key = find_key(sdl, event->key.keysym.sym);
+            if (key >= 0)
+                set_input_key(sdl, key, true);
             break;
-        case 0xF000:
-            switch (chip8->opcode & 0x00FF) {
-                case 0x0007:  // FX07; Sets VX to the value of the delay timer.
-                    chip8->V[X] = chip8->delay_timer;
-                    break;
-                case 0x000A:  // FX0A; A key press is awaited, and then stored
-                              // in VX.
-
-                    // Loop through keypad to see if a key has been pressed in
-                    // this frame.
-                    for (size_t i = 0; i < sizeof(chip8->keypad); i++) {
-                        if (chip8->keypad[i]) {
-                            chip8->V[X] = chip8->keypad[i];
-                            key_pressed = true;
-                        }
-                    }
-
-                    // Go back to this instruction if a key hasn't been pressed
-                    if (!key_pressed)
-                        chip8->pc -= 2;
-
-                    break;
-                case 0x0015:  // FX15; Sets the delay timer to VX.
-                    chip8->delay_timer = chip8->V[X];
-                    break;
-                case 0x0018:  // FX18; Sets the sound timer to VX.
-                    chip8->sound_timer = chip8->V[X];
-                    break;
-                case 0x001E:  // FX1E; Adds VX to I.
-                    chip8->idx += chip8->V[X];
-                    break;
-                case 0x0029:  // FX29; Sets I to the location of the sprite for
-                              // the character in VX.
-                    chip8->idx = FONT_START + (chip8->V[X] * FONT_HEIGHT);
-                    break;
-                case 0x0033:  // FX33; Stores the binary-coded decimal
-                              // representation of VX in I.
-                    n = chip8->V[X];
-                    chip8->memory[chip8->idx + 2] = n % 10;  // Hundreds digit
-                    n /= 10;
-                    chip8->memory[chip8->idx + 1] = n % 10;  // Tens digit
-                    chip8->memory[chip8->idx] = n / 10;      // Ones digit
-                    break;
-                case 0x0055:  // FX55; Stores from V0 to VX (including VX) in
-                              // memory, starting at address I.
-                    for (size_t i = 0; i <= X; i++) {
-                        chip8->memory[chip8->idx + i] = chip8->V[i];
-                    }
-                    break;
-                case 0x0065:  // FX65; Fills from V0 to VX (including VX) with
-                              // values from memory, starting at address I.
-                    for (size_t i = 0; i <= X; i++) {
-                        chip8->V[i] = chip8->memory[chip8->idx + i];
-                    }
-                    break;
-                default: break;
-            }
+        case SDL_KEYUP:
+            if (event->key.keysym.sym == SDLK_BACKSPACE)
+                SDL_AtomicSet(&sdl->input_rewind, 0);
+            key = find_key(sdl, event->key.keysym.sym);
+            if (key >= 0)
+                set_input_key(sdl, key, false);
             break;
         default: break;
     }
 }
 
-void handle_input(chip8_t *chip8) {
+// Handle every event waiting
+void handle_input(sdl_t *sdl) {
     SDL_Event event;
     while (SDL_PollEvent(&event)) {
-        switch (event.type) {
-            case SDL_QUIT: chip8->state = QUIT; return;
-            case SDL_KEYDOWN:
-                switch (event.key.keysym.sym) {
-                    case SDLK_ESCAPE: chip8->state = QUIT; return;
-                    case SDLK_1: chip8->keypad[0x1] = true; break;
-                    case SDLK_2: chip8->keypad[0x2] = true; break;
-                    case SDLK_3: chip8->keypad[0x3] = true; break;
-                    case SDLK_4: chip8->keypad[0x4] = true; break;
-                    case SDLK_q: chip8->keypad[0x4] = true; break;
-                    case SDLK_w: chip8->keypad[0x5] = true; break;
-                    case SDLK_e: chip8->keypad[0x6] = true; break;
-                    case SDLK_r: chip8->keypad[0xD] = true; break;
-                    case SDLK_a: chip8->keypad[0x7] = true; break;
-                    case SDLK_s: chip8->keypad[0x8] = true; break;
-                    case SDLK_d: chip8->keypad[0x9] = true; break;
-                    case SDLK_f: chip8->keypad[0xE] = true; break;
-                    case SDLK_z: chip8->keypad[0xA] = true; break;
-                    case SDLK_x: chip8->keypad[0x0] = true; break;
-                    case SDLK_c: chip8->keypad[0xB] = true; break;
-                    case SDLK_v: chip8->keypad[0xF] = true; break;
-                    default: break;
-                }
-                break;
-            case SDL_KEYUP:
-                switch (event.key.keysym.sym) {
-                    case SDLK_1: chip8->keypad[0x1] = false; break;
-                    case SDLK_2: chip8->keypad[0x2] = false; break;
-                    case SDLK_3: chip8->keypad[0x3] = false; break;
-                    case SDLK_4: chip8->keypad[0x4] = false; break;
-                    case SDLK_q: chip8->keypad[0x4] = false; break;
-                    case SDLK_w: chip8->keypad[0x5] = false; break;
-                    case SDLK_e: chip8->keypad[0x6] = false; break;
-                    case SDLK_r: chip8->keypad[0xD] = false; break;
-                    case SDLK_a: chip8->keypad[0x7] = false; break;
-                    case SDLK_s: chip8->keypad[0x8] = false; break;
-                    case SDLK_d: chip8->keypad[0x9] = false; break;
-                    case SDLK_f: chip8->keypad[0xE] = false; break;
-                    case SDLK_z: chip8->keypad[0xA] = false; break;
-                    case SDLK_x: chip8->keypad[0x0] = false; break;
-                    case SDLK_c: chip8->keypad[0xB] = false; break;
-                    case SDLK_v: chip8->keypad[0xF] = false; break;
-                    default: break;
-                }
-                break;
-            default: break;
-        }
+        handle_event(sdl, &event);
     }
 }
 
-void update_display(chip8_t *chip8) {
-    SDL_Rect rect = {.x = 0, .y = 0, .w = WINDOW_SCALE, .h = WINDOW_SCALE};
+// Take the input gathered since the last frame. Runs wherever frames are
+// emulated.
+void read_input(chip8_t *chip8) {
+    sdl_t *sdl = &chip8->sdl;
+    if (SDL_AtomicGet(&sdl->input_quit)) {
+        chip8->state = QUIT;
+        return;
+    }
 
-    // Draw each rectangle of the CHIP-8 display to the screen
-    for (size_t i = 0; i < sizeof(chip8->display); i++) {
-        rect.x = (i % DISPLAY_WIDTH) * WINDOW_SCALE;
-        rect.y = (i / DISPLAY_WIDTH) * WINDOW_SCALE;
+    int keys = SDL_AtomicGet(&sdl->input_keys);
+    for (int i = 0; i < 16; i++) {
+        chip8->keypad[i] = keys >> i & 1;
+    }
+    sdl->rewinding = SDL_AtomicGet(&sdl->input_rewind);
 
-        // Set draw color
-        uint8_t r = 0, g = 0, b = 0;
-        if (chip8->display[i]) {
-            r = 255, g = 255, b = 255;
-        }
+    int action = SDL_AtomicSet(&sdl->input_slot, 0);
+    if (action > 0)
+        use_slot(chip8, (action - 1) & ~SLOT_SAVE, action & SLOT_SAVE);
+}
 
-        SDL_SetRenderDrawColor(chip8->sdl.renderer, r, g, b, SDL_ALPHA_OPAQUE);
-        SDL_RenderFillRect(chip8->sdl.renderer, &rect);
+void update_timers(chip8_t *chip8) {
+    audio_t *audio = &chip8->sdl.audio;
+    if (chip8->sound_timer > 0 || chip8->sound_edge_count > 0)
+        start_audio(audio);
+
+    audio_params_t tone;
+    memcpy(tone.pattern, chip8->pattern, sizeof(tone.pattern));
+    tone.pitch = chip8->pitch;
+    update_audio(audio, &tone);
+
+    // The tone plays for as long as the sound timer is running. Starts and
+    // stops by FX18 land on their instruction, and the timer running out
+    // on the end of the frame.
+    double when = 0.0;
+    for (int i = 0; i < chip8->sound_edge_count; i++) {
+        const sound_edge_t *edge = &chip8->sound_edges[i];
+        when = (double)edge->cycle / chip8->ipf;
+        queue_sound(audio, edge->playing, when);
     }
+    queue_sound(audio, chip8->sound_timer > 0, when);
+    chip8->sound_edge_count = 0;
 
-    SDL_RenderPresent(chip8->sdl.renderer);
+    tick_timers(chip8);
+    queue_sound(audio, chip8->sound_timer > 0, 1.0);
+    advance_audio(audio);
 }
 
-void update_timers(chip8_t *chip8) {
+// Count the timers down without touching audio, for frames that are
+// emulated but never heard
+void tick_timers(chip8_t *chip8) {
     if (chip8->delay_timer > 0) {
         chip8->delay_timer--;
     }
 
     if (chip8->sound_timer > 0) {
         chip8->sound_timer--;
-        if (!Mix_Playing(-1)) {
-            Mix_PlayChannel(-1, chip8->sdl.sound, -1);
-        }
-    } else {
-        Mix_HaltChannel(-1);
     }
 }
 
 void cleanup(sdl_t *sdl) {
-    SDL_DestroyRenderer(sdl->renderer);
+    if (sdl->capture) {
+        capture_close(sdl->capture);
+        sdl->capture = NULL;
+    }
+    if (sdl->rewind) {
+        rewind_close(sdl->rewind);
+        sdl->rewind = NULL;
+    }
+    if (sdl->movie) {
+        movie_close(sdl->movie);
+        sdl->movie = NULL;
+    }
+    if (sdl->netplay) {
+        fprintf(stderr, "Netplay rolled back %d frames\n",
+                netplay_rollbacks(sdl->netplay));
+        netplay_close(sdl->netplay);
+        sdl->netplay = NULL;
+    }
+    if (sdl->slots) {
+        slots_close(sdl->slots);
+        sdl->slots = NULL;
+    }
+    if (sdl->hash_log) {
+        fclose(sdl->hash_log);
+        sdl->hash_log = NULL;
+    }
+    if (sdl->wav) {
+        wav_close(sdl->wav);
+        sdl->wav = NULL;
+    }
+
+    close_display(sdl);
     SDL_DestroyWindow(sdl->window);
     sdl->window = NULL;
-    sdl->renderer = NULL;
-    Mix_FreeChunk(sdl->sound);
-    Mix_CloseAudio();
+    close_audio(&sdl->audio);
     SDL_Quit();
 }
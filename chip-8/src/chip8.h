@@ -6,74 +6,309 @@ Properties and methods used by CHIP-8.
 #define CHIP8_H
 
 #include <SDL.h>
-#include <SDL_mixer.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 
+#include "profile.h"
+
 #define WINDOW_X 0
 #define WINDOW_Y 50
-#define WINDOW_SCALE 15
+#define WINDOW_SCALE 15  // Default initial window scale
+
+#define LORES_WIDTH 64
+#define LORES_HEIGHT 32
+#define HIRES_WIDTH 128  // SUPER-CHIP high resolution mode
+#define HIRES_HEIGHT 64
+
+#define DISPLAY_MAX_WIDTH HIRES_WIDTH
+#define DISPLAY_MAX_HEIGHT HIRES_HEIGHT
+#define DISPLAY_ROW_WORDS (DISPLAY_MAX_WIDTH / 64)  // 64 pixels per word
+#define DISPLAY_PLANES 2                            // XO-CHIP bitplanes
 
-#define DISPLAY_WIDTH 64
-#define DISPLAY_HEIGHT 32
+#define SCROLL_PIXELS 4  // 00FB/00FC distance in hires pixels
 
-#define SOUND_PATH "chip-8/data/beep.wav"
+#define MEMORY_SIZE 0x10000  // XO-CHIP address space; CHIP-8 uses 4k of it
+#define MEMORY_MASK (MEMORY_SIZE - 1)
+#define MEMORY_PAGE_SIZE 256  // Granularity of dirty memory tracking
+#define MEMORY_PAGES (MEMORY_SIZE / MEMORY_PAGE_SIZE)
 
-#define MEMORY_SIZE 4096
+#define AUDIO_SAMPLE_RATE 44100
+#define AUDIO_MIN_SAMPLE_RATE 4000     // Rates a WAV can be rendered at
+#define AUDIO_MAX_SAMPLE_RATE 192000
+#define AUDIO_BUFFER_SAMPLES 512  // About 12 ms of latency
+#define AUDIO_PATTERN_SIZE 16   // XO-CHIP pattern, 128 one bit samples
+#define AUDIO_DEFAULT_PITCH 64  // FX3A value for 4000 pattern bits/second
+#define AUDIO_VOLUME 3000       // Amplitude of the square wave
+#define AUDIO_EVENTS 256        // Sound starts and stops queued at most
+#define AUDIO_MAX_LEAD 4096     // Samples an event may be ahead of output
+#define AUDIO_SYNC_LEAD 2048    // Samples kept queued when paced by audio
+#define AUDIO_MAX_SKEW 0.005    // Largest change to samples per frame
+#define SOUND_EDGES 8           // Sound starts and stops kept per frame
 
 #define PC_START 0x200
-#define PC_END 0xFFF
-#define MAX_ROM_SIZE (PC_END - PC_START)  // 3,583 bytes
+#define MAX_ROM_SIZE (MEMORY_SIZE - PC_START)  // 65,024 bytes
 
 #define FONT_HEIGHT 5
 #define FONT_START 0x50
 #define FONT_END 0xA0
 #define FONT_MEMORY_SIZE (FONT_END - FONT_START)  // 80 bytes
 
+#define BIG_FONT_HEIGHT 10
+#define BIG_FONT_START FONT_END
+#define BIG_FONT_END 0x140
+#define BIG_FONT_MEMORY_SIZE (BIG_FONT_END - BIG_FONT_START)  // 160 bytes
+
+#define RPL_FLAGS 16  // HP48 RPL user flags for FX75/FX85
+
 #define DEFAULT_PC_INCREMENT 2
 
+#define INSTRUCTIONS_PER_FRAME 11  // Default, 660 instructions per second
+#define MAX_IPF 0xFFFF  // Most instructions per frame files can hold
+
+#define RENDER_WAIT_MS 100  // Display loop wakeup interval with no frames
+#define FADE_WAIT_MS 16     // Display loop wakeup interval while fading
+
+
+// Display rows are packed one bit per pixel, 64 pixels per word with the
+// leftmost pixel in the most significant bit
+typedef uint64_t display_row_t[DISPLAY_ROW_WORDS];
+typedef display_row_t display_plane_t[DISPLAY_MAX_HEIGHT];
+
+// Completed framebuffer handed from the emulator to the renderer
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    display_plane_t planes[DISPLAY_PLANES];
+} frame_t;
+
+// Lock-free triple buffer over three caller-owned slots. The producer fills
+// slot `back` and swaps it with the shared middle slot; the consumer swaps
+// the middle slot into `front` whenever a fresh one has been published.
+typedef struct {
+    SDL_atomic_t middle;  // Index of the shared slot, plus the fresh flag
+    int back;             // Owned by the producer thread
+    int front;            // Owned by the consumer thread
+} triple_buffer_t;
+
+// Frames handed from the emulator to the display loop
+typedef struct {
+    frame_t frames[3];
+    triple_buffer_t slots;
+} frame_buffer_t;
+
+// Tone handed from the emulator to the audio callback
+typedef struct {
+    uint8_t pattern[AUDIO_PATTERN_SIZE];
+    uint8_t pitch;
+} audio_params_t;
+
+// The sound timer starting or stopping, at a time in samples of emulation
+typedef struct {
+    double time;
+    bool playing;
+} audio_event_t;
+
+// Audio device fed by a callback, which never waits on emulation. Sound
+// timer starts and stops go through a queue, stamped with when they
+// happened, so the callback can place them on the exact sample. The tone,
+// which only XO-CHIP changes, goes through the triple buffer.
+typedef struct {
+    SDL_AudioDeviceID device;  // 0 when no device is open
+    int sample_rate;           // Rate the device runs at
+    bool wanted;               // Open the device once sound first plays
+    SDL_Thread *opener;        // Opening the device, or NULL
+    audio_params_t params[3];  // Slots of the triple buffer
+    triple_buffer_t slots;
+    audio_params_t published;  // Last tone published by the emulator
+
+    audio_event_t events[AUDIO_EVENTS];  // Ring from emulator to callback
+    SDL_atomic_t event_head;             // Next event written, by emulator
+    SDL_atomic_t event_tail;             // Next event read, by callback
+    double clock;                        // Start of the frame, in samples
+    double ratio;                        // Samples per frame over nominal
+    bool queued;                         // Sound state last queued
+    SDL_atomic_t played;                 // Event time reached by output
+
+    double phase;     // Pattern position in bits, owned by callback
+    bool playing;     // Sound state, owned by callback
+    double rendered;  // Samples rendered, owned by callback
+    double offset;    // Event time to output time, owned by callback
+} audio_t;
+
+// The sound timer starting or stopping during a frame
+typedef struct {
+    int cycle;  // Instruction of the frame it happened on
+    bool playing;
+} sound_edge_t;
+
+typedef struct capture capture_t;
+typedef struct rewind_buffer rewind_buffer_t;
+typedef struct movie movie_t;
+typedef struct netplay netplay_t;
+typedef struct save_slots save_slots_t;
+typedef struct wav wav_t;
+
 // SDL Object
 typedef struct {
     SDL_Window *window;
     SDL_Renderer *renderer;
-    Mix_Chunk *sound;
+    SDL_Texture *texture;          // Frame, sized for the largest display
+    SDL_Texture *persist_texture;  // Accumulated phosphor image, or NULL
+    audio_t audio;
+
+    int scale;            // Initial window scale (0 = WINDOW_SCALE)
+    int width;            // Resolution of the frame on screen
+    int height;
+    uint8_t persistence;  // Brightness kept per frame (0 = no persistence)
+    int fade_frames;      // Frames for a lit pixel to decay to black
+    int fade_left;        // Idle frames left in the current decay
+
+    frame_buffer_t frames;       // Frames awaiting presentation
+    bool threaded;               // Frames are emulated on their own thread
+    SDL_atomic_t emulating;      // Cleared when the emulation thread ends
+    uint32_t wake_event;         // Event type that wakes the display loop
+    SDL_atomic_t frame_pending;  // Wake event sent and not yet handled
+
+    // Input gathered by the event loop for the emulator to take each frame
+    SDL_Keycode keymap[16];    // Key for each CHIP-8 key
+    SDL_atomic_t input_keys;   // CHIP-8 keys held, one bit each
+    SDL_atomic_t input_rewind; // Rewind key held
+    SDL_atomic_t input_slot;   // Quick-save slot action waiting, 0 = none
+    SDL_atomic_t input_quit;   // Window closed or Escape pressed
+
+    bool headless;            // No window, audio or frame pacing
+    FILE *hash_log;           // State hash of every frame, or NULL
+    capture_t *capture;       // Frame capture, or NULL
+    rewind_buffer_t *rewind;  // Rewind history, or NULL
+    bool rewinding;           // Rewind key held
+    movie_t *movie;           // Input movie being recorded or replayed
+    bool unthrottled;         // Run frames without pacing
+    bool audio_sync;          // Pace frames by the audio device
+    int run_ahead;            // Frames shown ahead of the input, 0 = off
+    netplay_t *netplay;       // Session with another player, or NULL
+    save_slots_t *slots;      // Quick-save slots of the ROM, or NULL
+    wav_t *wav;               // Audio rendered by headless runs, or NULL
 } sdl_t;
 
+// Users of dirty page tracking. Each clears its own bitmap, so one
+// catching up doesn't hide writes from another.
+typedef enum {
+    DIRTY_REWIND,  // Rewind history
+    DIRTY_HASH,    // State hash
+    DIRTY_CLONE,   // Cloning; chip8_clone_prepare clears pages of zeros
+    DIRTY_USERS
+} dirty_user_t;
+
 // CHIP-8 States
 typedef enum { RUNNING, PAUSED, QUIT } state_t;
 
-// CHIP-8 Object
+// Behaviour that can be changed at runtime. Quirks in the hot path are
+// compiled into each profile's interpreter instead (see interpreter.inc).
+typedef struct {
+    bool display_wait;  // DXYN waits for vblank, ending the frame's budget
+} quirks_t;
+
+// CHIP-8 Object. Everything before `sdl` is emulation state, kept in one
+// span so save states are a single copy.
 typedef struct {
     uint16_t pc;      // Program counter
     uint16_t opcode;  // Current opcode
     uint16_t idx;     // Index register
     uint16_t sp;      // Stack pointer
 
-    uint8_t V[16];                                 // V-registers (V0-VF)
-    uint16_t stack[16];                            // Stack (16 levels)
-    uint8_t memory[MEMORY_SIZE];                   // Memory (size = 4k)
-    bool display[DISPLAY_WIDTH * DISPLAY_HEIGHT];  // Graphics
-    bool keypad[16];                               // Keypad
+    uint8_t V[16];                            // V-registers (V0-VF)
+    uint16_t stack[16];                       // Stack (16 levels)
+    uint8_t memory[MEMORY_SIZE];              // Memory (size = 64k)
+    display_plane_t display[DISPLAY_PLANES];  // Graphics
+    bool keypad[16];                          // Keypad
+    uint8_t rpl[RPL_FLAGS];                   // RPL user flags
+
+    bool hires;               // SUPER-CHIP high resolution mode
+    uint16_t display_width;   // Current resolution
+    uint16_t display_height;
+    uint8_t planes;           // XO-CHIP bitplanes selected for drawing
 
     uint8_t delay_timer;  // Delay timer
     uint8_t sound_timer;  // Sound timer
 
-    state_t state;  // Current running state
-    sdl_t sdl;      // SDL object
+    uint8_t pattern[AUDIO_PATTERN_SIZE];  // XO-CHIP audio pattern
+    uint8_t pitch;                        // XO-CHIP playback pitch
+
+    uint32_t rng;  // xorshift32 state for CXNN, never 0
+
+    state_t state;      // Current running state
+    profile_t profile;  // Emulated platform
+    quirks_t quirks;    // Quirks of the emulated platform
+    int ipf;            // Instructions per frame
 
     bool draw;  // Draw flag
+
+    sdl_t sdl;  // SDL object
+
+    // Memory pages written since each user last called clear_dirty_pages.
+    // Every store goes through write_memory, so users can skip clean pages.
+    uint64_t dirty[DIRTY_USERS][MEMORY_PAGES / 64];
+
+    // Sound timer starts and stops of the last frame emulated, so audio can
+    // place them within the frame
+    sound_edge_t sound_edges[SOUND_EDGES];
+    int sound_edge_count;
+    int frame_cycle;  // Instruction of the frame being run
 } chip8_t;
 
 void initialize(chip8_t *chip8);
 long get_rom_size(FILE *fp);
-bool read_rom(uint8_t *buffer, const char *rom_path);
+size_t read_rom(uint8_t *buffer, const char *rom_path);
 bool setup_sdl(sdl_t *sdl);
 void mainloop(void *arg);
-void handle_input(chip8_t *chip8);
+void handle_event(sdl_t *sdl, const SDL_Event *event);
+void handle_input(sdl_t *sdl);
+void read_input(chip8_t *chip8);
+void set_profile(chip8_t *chip8, profile_t profile);
+void seed_rng(chip8_t *chip8, uint32_t seed);
+void emulate_frame(chip8_t *chip8);
 void emulate_cycle(chip8_t *chip8);
-void update_display(chip8_t *chip8);
+void set_resolution(chip8_t *chip8, bool hires);
+void write_memory(chip8_t *chip8, uint16_t address, uint8_t value);
+bool is_page_dirty(const chip8_t *chip8, dirty_user_t user, int page);
+void mark_all_dirty(chip8_t *chip8);
+void clear_dirty_pages(chip8_t *chip8, dirty_user_t user);
+bool get_pixel(const display_row_t *rows, int x, int y);
+int get_color(const display_plane_t *planes, int x, int y);
+void publish_frame(chip8_t *chip8);
+void update_display(sdl_t *sdl, const frame_t *frame);
 void update_timers(chip8_t *chip8);
+void tick_timers(chip8_t *chip8);
 void cleanup(sdl_t *sdl);
 
+// Triple buffer
+void init_triple_buffer(triple_buffer_t *tb);
+void swap_back(triple_buffer_t *tb);
+bool swap_front(triple_buffer_t *tb);
+
+// Rendering
+void init_frame_buffer(frame_buffer_t *fb);
+int fade_length(uint8_t persistence);
+bool open_display(sdl_t *sdl);
+void close_display(sdl_t *sdl);
+void present_frames(sdl_t *sdl, bool tick);
+void run_display(sdl_t *sdl);
+void wake_display(sdl_t *sdl);
+void resize_display(sdl_t *sdl);
+void reset_display(sdl_t *sdl);
+
+// Audio
+void init_audio(audio_t *audio);
+bool open_audio(audio_t *audio);
+void start_audio(audio_t *audio);
+void close_audio(audio_t *audio);
+void update_audio(audio_t *audio, const audio_params_t *params);
+void queue_sound(audio_t *audio, bool playing, double when);
+void advance_audio(audio_t *audio);
+int audio_lead(audio_t *audio);
+void pace_audio(audio_t *audio);
+void render_audio(audio_t *audio, int16_t *samples, int count);
+int render_frame_audio(audio_t *audio, int16_t *samples, int max);
+
 #endif /* CHIP8_H */
\ No newline at end of file
@@ -1,22 +1,233 @@
 #include <SDL.h>
+#include <inttypes.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
 #endif
 
+#include "capture.h"
 #include "chip8.h"
+#include "movie.h"
+#include "netplay.h"
+#include "rewind.h"
+#include "romdb.h"
+#include "saveslots.h"
+#include "savestate.h"
+#include "statehash.h"
+#include "wav.h"
+
+#define HEADLESS_FRAMES 3600  // Default headless run length (one minute)
+#define RUN_AHEAD_MAX 8        // Most frames emulated ahead of the input
+#define NETPLAY_POLL_MS 4      // Netplay packet exchange interval while idle
+
+// Command line options
+typedef struct {
+    char *rom_path;
+    int scale;           // Initial window scale
+    int persistence;     // Phosphor persistence, 0-255
+    profile_t profile;   // Emulated platform, PROFILE_COUNT = ROM default
+    int display_wait;    // Display wait quirk override, -1 = profile default
+    bool headless;       // Run without a window or frame pacing
+    long frames;         // Frames to run in headless mode, 0 = default
+    char *capture_path;  // Frame capture output, or NULL
+    int capture_every;   // Capture every Nth frame
+    int rewind;          // Seconds of rewind history, 0 = off
+    int rewind_memory;   // Rewind memory budget in MB
+    char *record_path;   // Input movie to record, or NULL
+    char *replay_path;   // Input movie to replay, or NULL
+    int run_ahead;       // Frames shown ahead of the input
+    char *hash_path;     // Per-frame state hash log, or NULL
+    char *peer;          // Netplay peer as host:port, or NULL
+    int port;            // Local netplay port
+    netplay_faults_t faults;  // Faults injected into netplay packets
+    bool audio_sync;     // Pace frames by the audio device
+    char *wav_path;      // Headless audio output, or NULL
+    int sample_rate;     // Rate of the headless audio output
+} options_t;
+
+static state_hash_t state_hash;  // Kept up to date when logging hashes
+
+static void usage(void) {
+    fprintf(stderr,
+            "Usage: chip8.exe [options] <rom_name>\n"
+            "  --scale <n>              Initial window scale (default 15)\n"
+            "  --persistence <0-255>    Phosphor persistence (0 = off)\n"
+            "  --profile <name>         vip, schip, schip-modern or xochip\n"
+            "  --display-wait <on|off>  Override the display wait quirk\n"
+            "  --headless               Run without a window at full speed\n"
+            "  --frames <n>             Frames to run headless (default 3600,\n"
+            "                           or the whole movie when replaying)\n"
+            "  --capture <path>         Capture frames to a .y4m file or a\n"
+            "                           .ppm pattern such as frame_%%05d.ppm\n"
+            "  --capture-every <n>      Capture every Nth frame (default 1)\n"
+            "  --rewind <seconds>       Rewind history, 0 = off (default 10)\n"
+            "  --rewind-memory <MB>     Rewind memory budget (default 16)\n"
+            "  --record <path>          Record the keypad to an input movie\n"
+            "  --replay <path>          Replay an input movie at full speed\n"
+            "  --run-ahead <0-8>        Frames shown ahead of the input\n"
+            "  --hash-log <path>        Log a hash of the state every frame\n"
+            "  --netplay <host:port>    Play against a peer over UDP\n"
+            "  --port <n>               Local netplay port (default 6502)\n"
+            "  --net-delay <ms>         Delay every netplay packet sent\n"
+            "  --net-loss <percent>     Drop netplay packets sent\n"
+            "  --audio-sync             Pace frames by the audio device\n"
+            "  --wav <path>             Render headless audio to a .wav\n"
+            "  --sample-rate <n>        Rate of the .wav (default 44100)\n");
+}
+
+static bool parse_args(int argc, char *argv[], options_t *options) {
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+
+        if (strcmp(argv[i], "--scale") == 0 && has_value) {
+            options->scale = atoi(argv[++i]);
+            if (options->scale < 1)
+                return false;
+        } else if (strcmp(argv[i], "--persistence") == 0 && has_value) {
+            options->persistence = atoi(argv[++i]);
+            if (options->persistence < 0 || options->persistence > 255)
+                return false;
+        } else if (strcmp(argv[i], "--profile") == 0 && has_value) {
+            if (!parse_profile(argv[++i], &options->profile))
+                return false;
+        } else if (strcmp(argv[i], "--display-wait") == 0 && has_value) {
+            const char *value = argv[++i];
+            if (strcmp(value, "on") == 0) {
+                options->display_wait = 1;
+            } else if (strcmp(value, "off") == 0) {
+                options->display_wait = 0;
+            } else {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--headless") == 0) {
+            options->headless = true;
+        } else if (strcmp(argv[i], "--frames") == 0 && has_value) {
+            options->frames = atol(argv[++i]);
+            if (options->frames < 1)
+                return false;
+        } else if (strcmp(argv[i], "--capture") == 0 && has_value) {
+            options->capture_path = argv[++i];
+        } else if (strcmp(argv[i], "--capture-every") == 0 && has_value) {
+            options->capture_every = atoi(argv[++i]);
+            if (options->capture_every < 1)
+                return false;
+        } else if (strcmp(argv[i], "--rewind") == 0 && has_value) {
+            options->rewind = atoi(argv[++i]);
+            if (options->rewind < 0)
+                return false;
+        } else if (strcmp(argv[i], "--rewind-memory") == 0 && has_value) {
+            options->rewind_memory = atoi(argv[++i]);
+            if (options->rewind_memory < 1)
+                return false;
+        } else if (strcmp(argv[i], "--record") == 0 && has_value) {
+            options->record_path = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && has_value) {
+            options->replay_path = argv[++i];
+        } else if (strcmp(argv[i], "--run-ahead") == 0 && has_value) {
+            options->run_ahead = atoi(argv[++i]);
+            if (options->run_ahead < 0 || options->run_ahead > RUN_AHEAD_MAX)
+                return false;
+        } else if (strcmp(argv[i], "--hash-log") == 0 && has_value) {
+            options->hash_path = argv[++i];
+        } else if (strcmp(argv[i], "--netplay") == 0 && has_value) {
+            options->peer = argv[++i];
+        } else if (strcmp(argv[i], "--port") == 0 && has_value) {
+            options->port = atoi(argv[++i]);
+            if (options->port < 1 || options->port > 0xFFFF)
+                return false;
+        } else if (strcmp(argv[i], "--net-delay") == 0 && has_value) {
+            options->faults.delay_ms = atoi(argv[++i]);
+            if (options->faults.delay_ms < 0)
+                return false;
+        } else if (strcmp(argv[i], "--net-loss") == 0 && has_value) {
+            options->faults.loss = atoi(argv[++i]);
+            if (options->faults.loss < 0 || options->faults.loss > 100)
+                return false;
+        } else if (strcmp(argv[i], "--audio-sync") == 0) {
+            options->audio_sync = true;
+        } else if (strcmp(argv[i], "--wav") == 0 && has_value) {
+            options->wav_path = argv[++i];
+        } else if (strcmp(argv[i], "--sample-rate") == 0 && has_value) {
+            options->sample_rate = atoi(argv[++i]);
+            if (options->sample_rate < AUDIO_MIN_SAMPLE_RATE ||
+                options->sample_rate > AUDIO_MAX_SAMPLE_RATE)
+                return false;
+        } else if (argv[i][0] == '-') {
+            return false;
+        } else {
+            options->rom_path = argv[i];
+        }
+    }
+
+    return true;
+}
+
+// Log the hash of the frame just emulated, one hex number per line
+static void log_hash(chip8_t *chip8) {
+    uint64_t hash = hash_state(&state_hash, chip8);
+    fprintf(chip8->sdl.hash_log, "%016" PRIx64 "\n", hash);
+}
+
+// Run a fixed number of frames as fast as possible, without a window. The
+// sound of each frame is rendered in one go once its timers have ticked.
+static void run_headless(chip8_t *chip8, long frames) {
+    static int16_t samples[AUDIO_MAX_SAMPLE_RATE / 50];
+
+    for (long frame = 0; frame < frames && chip8->state == RUNNING; frame++) {
+        if (chip8->sdl.movie && !movie_frame(chip8->sdl.movie, chip8))
+            break;
+
+        emulate_frame(chip8);
+        chip8->draw = false;
+
+        if (chip8->sdl.hash_log)
+            log_hash(chip8);
+
+        if (chip8->sdl.capture)
+            capture_frame(chip8->sdl.capture, chip8);
+
+        update_timers(chip8);
+
+        if (chip8->sdl.wav) {
+            int count = render_frame_audio(&chip8->sdl.audio, samples,
+                                           sizeof(samples) / sizeof(*samples));
+            if (!wav_write(chip8->sdl.wav, samples, count)) {
+                fprintf(stderr, "Error: Could not write audio\n");
+                break;
+            }
+        }
+    }
+}
+
+static int emulation_loop(void *arg);
 
 int main(int argc, char *argv[]) {
-    (void)argc;
+    options_t options = {.scale = WINDOW_SCALE,
+                         .profile = PROFILE_COUNT,
+                         .display_wait = -1,
+                         .capture_every = 1,
+                         .rewind = REWIND_SECONDS,
+                         .rewind_memory = REWIND_MEMORY_MB,
+                         .port = NETPLAY_PORT,
+                         .sample_rate = AUDIO_SAMPLE_RATE};
+    bool parsed = parse_args(argc, argv, &options);
 #ifndef __EMSCRIPTEN__
-    if (argc < 2) {
-        fprintf(stderr, "Usage: chip8.exe <rom_name>\n");
+    parsed = parsed && options.rom_path != NULL;
+#endif
+    parsed = parsed && !(options.record_path && options.replay_path);
+    parsed = parsed && !(options.wav_path && !options.headless);
+    parsed = parsed && !(options.peer && (options.headless ||
+                                          options.record_path ||
+                                          options.replay_path));
+    if (!parsed) {
+        usage();
         exit(EXIT_FAILURE);
     }
-#endif
 
     for (int i = 0; i < argc; i++) {
         printf("%s\n", argv[i]);
@@ -24,16 +235,133 @@ int main(int argc, char *argv[]) {
 
     chip8_t chip8;
     initialize(&chip8);
-    if (!setup_sdl(&chip8.sdl))
+    size_t rom_size = read_rom(&chip8.memory[PC_START], options.rom_path);
+    if (rom_size == 0)
         exit(EXIT_FAILURE);
 
-    char *rom_path = argv[1];
-    if (!read_rom(&chip8.memory[PC_START], rom_path))
+    // Known ROMs bring their own settings; options still take precedence
+    rom_info_t rom;
+    if (find_rom(ROMDB_PATH, &chip8.memory[PC_START], rom_size, &rom))
+        apply_rom_info(&chip8, &rom);
+    if (options.profile != PROFILE_COUNT)
+        set_profile(&chip8, options.profile);
+    if (options.display_wait >= 0)
+        chip8.quirks.display_wait = options.display_wait;
+
+    // A replay restores the recorded settings and seed, and runs as fast as
+    // possible
+    const uint8_t *image = &chip8.memory[PC_START];
+    if (options.record_path) {
+        chip8.sdl.movie =
+            movie_record(options.record_path, &chip8, image, rom_size);
+    } else if (options.replay_path) {
+        chip8.sdl.movie =
+            movie_replay(options.replay_path, &chip8, image, rom_size);
+        chip8.sdl.unthrottled = true;
+    }
+    if ((options.record_path || options.replay_path) && !chip8.sdl.movie)
         exit(EXIT_FAILURE);
 
+    chip8.sdl.scale = options.scale;
+    chip8.sdl.persistence = options.persistence;
+    chip8.sdl.headless = options.headless;
+    chip8.sdl.run_ahead = options.run_ahead;
+    if (!chip8.sdl.headless && !setup_sdl(&chip8.sdl))
+        exit(EXIT_FAILURE);
+
+    // Pacing by audio needs the device from the start. Without one there is
+    // nothing to pace by, so the clock is used after all.
+    if (options.audio_sync && !chip8.sdl.headless) {
+        chip8.sdl.audio.wanted = false;
+        chip8.sdl.audio_sync = open_audio(&chip8.sdl.audio);
+        if (!chip8.sdl.audio_sync)
+            fprintf(stderr, "Error: No audio device to pace by\n");
+    }
+
+    if (options.capture_path) {
+        // Headless runs wait for the writer so no frame is ever dropped.
+        // Platforms with a hires mode are captured at that size throughout.
+        bool hires = chip8.profile != PROFILE_VIP;
+        chip8.sdl.capture = capture_open(
+            options.capture_path, options.capture_every, options.headless,
+            hires ? HIRES_WIDTH : LORES_WIDTH,
+            hires ? HIRES_HEIGHT : LORES_HEIGHT);
+        if (!chip8.sdl.capture)
+            exit(EXIT_FAILURE);
+    }
+
+    // Headless runs have no device, so audio is rendered at the rate asked
+    if (options.wav_path) {
+        chip8.sdl.audio.sample_rate = options.sample_rate;
+        chip8.sdl.wav = wav_open(options.wav_path, options.sample_rate);
+        if (!chip8.sdl.wav)
+            exit(EXIT_FAILURE);
+    }
+
+    if (options.hash_path) {
+        chip8.sdl.hash_log = fopen(options.hash_path, "w");
+        if (!chip8.sdl.hash_log) {
+            fprintf(stderr, "Error: Could not create %s\n", options.hash_path);
+            exit(EXIT_FAILURE);
+        }
+        init_state_hash(&state_hash, &chip8);
+    }
+
+    // Both peers of a netplay session run from the same seed, which they
+    // agree on when connecting. Rolling back replaces run-ahead.
+    if (options.peer) {
+        chip8.sdl.netplay = netplay_open(options.port, options.peer, &chip8,
+                                         image, rom_size, &options.faults);
+        if (!chip8.sdl.netplay)
+            exit(EXIT_FAILURE);
+        chip8.sdl.run_ahead = 0;
+    }
+
+    // Headless runs take no input, so there is nothing to rewind. A movie
+    // holds one unbroken run, so rewinding can't be mixed with one either,
+    // nor can a netplay session, which is shared with the peer.
+    if (options.rewind > 0 && !chip8.sdl.headless && !chip8.sdl.movie &&
+        !chip8.sdl.netplay) {
+        chip8.sdl.rewind = rewind_open(
+            options.rewind, (size_t)options.rewind_memory * 1024 * 1024);
+        if (!chip8.sdl.rewind)
+            exit(EXIT_FAILURE);
+    }
+
+    // Quick-save slots sit next to the ROM. Loading one would break a movie
+    // or a netplay session, so neither has them.
+    if (!chip8.sdl.headless && !chip8.sdl.movie && !chip8.sdl.netplay) {
+        char slots_path[FILENAME_MAX];
+        snprintf(slots_path, sizeof(slots_path), "%s.sav", options.rom_path);
+        chip8.sdl.slots = slots_open(slots_path);
+    }
+
+    if (chip8.sdl.headless) {
+        long frames = options.frames;
+        if (frames == 0)
+            frames = options.replay_path ? LONG_MAX : HEADLESS_FRAMES;
+        run_headless(&chip8, frames);
+        cleanup(&chip8.sdl);
+        return 0;
+    }
+
 #ifdef __EMSCRIPTEN__
     emscripten_set_main_loop_arg(mainloop, (void *)&chip8, 0, 1);
 #else
+    // Frames are emulated on a thread of their own, while the window,
+    // renderer and events stay on this one as SDL requires
+    chip8.sdl.threaded = true;
+    SDL_AtomicSet(&chip8.sdl.emulating, 1);
+    SDL_Thread *thread =
+        SDL_CreateThread(emulation_loop, "emulation", &chip8);
+    if (thread) {
+        run_display(&chip8.sdl);
+        SDL_WaitThread(thread, NULL);
+        cleanup(&chip8.sdl);
+        return 0;
+    }
+
+    chip8.sdl.threaded = false;
     while (1) {
         mainloop(&chip8);
     }
@@ -41,45 +369,144 @@ int main(int argc, char *argv[]) {
     return 0;
 }
 
-void mainloop(void *arg) {
-    chip8_t *chip8 = (chip8_t *)arg;
+// Publish the frame `frames` ahead of the real one, emulated with the
+// current input, then restore the real state. A game that only reacts to a
+// key a few frames after reading it then appears to react at once.
+static void run_ahead(chip8_t *chip8, int frames) {
+    static uint8_t state[SAVESTATE_SIZE];
+    chip8_save_state(chip8, state, sizeof(state));
+    sound_edge_t edges[SOUND_EDGES];
+    int edge_count = chip8->sound_edge_count;
+    memcpy(edges, chip8->sound_edges, sizeof(edges));
 
-    if (chip8->state != RUNNING) {
-        cleanup(&chip8->sdl);
-#ifdef __EMSCRIPTEN__
-        emscripten_cancel_main_loop();
-#else
-        exit(0);
-#endif
+    for (int i = 0; i < frames && chip8->state == RUNNING; i++) {
+        tick_timers(chip8);
+        emulate_frame(chip8);
     }
+    publish_frame(chip8);
+
+    // Only pages written during the lookahead can differ from the real
+    // state, so the restore need not mark every page dirty
+    uint64_t dirty[DIRTY_USERS][MEMORY_PAGES / 64];
+    memcpy(dirty, chip8->dirty, sizeof(dirty));
+    chip8_load_state(chip8, state, sizeof(state));
+    memcpy(chip8->dirty, dirty, sizeof(dirty));
+    memcpy(chip8->sound_edges, edges, sizeof(edges));
+    chip8->sound_edge_count = edge_count;
+    chip8->draw = false;  // The future frame stands in for this one
+}
 
+// Wait out the rest of a frame while still exchanging netplay packets, so
+// delayed sends go out on time and the peer's input is in for the next frame
+static void wait_netplay(chip8_t *chip8, double delay_ms) {
+    uint32_t start = SDL_GetTicks();
+    uint32_t waited;
+    while ((waited = SDL_GetTicks() - start) < delay_ms) {
+        double left = delay_ms - waited;
+        SDL_Delay(left < NETPLAY_POLL_MS ? left : NETPLAY_POLL_MS);
+        if (!netplay_poll(chip8->sdl.netplay)) {
+            chip8->state = QUIT;
+            return;
+        }
+    }
+}
+
+// Emulate and pace one frame. Runs on the emulation thread, or inline from
+// mainloop where there are no threads.
+static void run_frame(chip8_t *chip8) {
     uint64_t start_time = SDL_GetPerformanceCounter();
 
-    handle_input(chip8);
+    read_input(chip8);
+    if (chip8->state != RUNNING)
+        return;
 
-    // 11 instructions per frame = 660 instructions per second
-    for (size_t i = 0; i < 11; i++) {
-        emulate_cycle(chip8);
+    // A movie records the keypad, or replaces it when replaying
+    if (chip8->sdl.movie && !movie_frame(chip8->sdl.movie, chip8)) {
+        chip8->state = QUIT;
+        return;
+    }
 
-        // If draw instruction, break to only draw once during this frame
-        if ((chip8->opcode >> 12) == 0xD)
-            break;
+    // Holding the rewind key steps back a frame at a time, and stops at the
+    // oldest frame held. Netplay holds the frame back while the peer's input
+    // lags too far behind.
+    bool ran = false;
+    if (chip8->sdl.rewinding) {
+        rewind_pop(chip8->sdl.rewind, chip8);
+        queue_sound(&chip8->sdl.audio, false, 0.0);
+    } else if (chip8->sdl.netplay) {
+        ran = netplay_frame(chip8->sdl.netplay, chip8);
+    } else {
+        emulate_frame(chip8);
+        ran = true;
+        if (chip8->sdl.rewind)
+            rewind_push(chip8->sdl.rewind, chip8);
     }
+    if (ran && chip8->sdl.hash_log)
+        log_hash(chip8);
 
-    if (chip8->draw) {
-        update_display(chip8);
+    if (chip8->sdl.run_ahead > 0 && !chip8->sdl.rewinding) {
+        run_ahead(chip8, chip8->sdl.run_ahead);
+    } else if (chip8->draw) {
+        publish_frame(chip8);
         chip8->draw = false;
     }
 
-    update_timers(chip8);
+    if (chip8->sdl.capture)
+        capture_frame(chip8->sdl.capture, chip8);
+
+    // Audio time moves on with or without a frame
+    if (ran)
+        update_timers(chip8);
+    else
+        advance_audio(&chip8->sdl.audio);
+
+    if (chip8->sdl.unthrottled)
+        return;
+    if (chip8->sdl.audio_sync) {
+        pace_audio(&chip8->sdl.audio);
+        return;
+    }
 
     uint64_t end_time = SDL_GetPerformanceCounter();
-    double elapsed_time =
-        (end_time - start_time) / (double)SDL_GetPerformanceFrequency();
+    double elapsed_time = (end_time - start_time) * 1000.0 /
+                          SDL_GetPerformanceFrequency();  // Milliseconds
 
     // Delay for the remainder of this current frame
     double delay_amount = 16.67f - elapsed_time;
-    if (delay_amount > 0) {
+    if (chip8->sdl.netplay) {
+        wait_netplay(chip8, delay_amount);
+    } else if (delay_amount > 0) {
         SDL_Delay(delay_amount);
     }
-}
\ No newline at end of file
+}
+
+// Emulate frames until the ROM or the player quits, then let the display
+// loop on the main thread know
+static int emulation_loop(void *arg) {
+    chip8_t *chip8 = (chip8_t *)arg;
+    while (chip8->state == RUNNING) {
+        run_frame(chip8);
+    }
+
+    SDL_AtomicSet(&chip8->sdl.emulating, 0);
+    wake_display(&chip8->sdl);  // Unless a wakeup is already on its way
+    return 0;
+}
+
+// Emulate and show one frame, for running without an emulation thread
+void mainloop(void *arg) {
+    chip8_t *chip8 = (chip8_t *)arg;
+
+    if (chip8->state != RUNNING) {
+        cleanup(&chip8->sdl);
+#ifdef __EMSCRIPTEN__
+        emscripten_cancel_main_loop();
+#else
+        exit(0);
+#endif
+    }
+
+    handle_input(&chip8->sdl);
+    run_frame(chip8);
+    present_frames(&chip8->sdl, true);
+}
@@ -0,0 +1,142 @@
+#include "movie.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MOVIE_MAX_RUN 0xFFFF
+
+struct movie {
+    FILE *fp;
+    bool replaying;
+    uint16_t keys;  // Keypad bits of the current run
+    uint32_t run;   // Frames recorded, or left to replay, in the run
+};
+
+static uint16_t pack_keypad(const chip8_t *chip8) {
+    uint16_t keys = 0;
+    for (int i = 0; i < 16; i++) {
+        keys |= chip8->keypad[i] << i;
+    }
+    return keys;
+}
+
+static movie_t *open_movie(const char *path, const char *mode) {
+    movie_t *movie = calloc(1, sizeof(*movie));
+    if (!movie) {
+        fprintf(stderr, "Error: Could not allocate movie\n");
+        return NULL;
+    }
+
+    movie->fp = fopen(path, mode);
+    if (!movie->fp) {
+        fprintf(stderr, "Error: Could not open movie %s\n", path);
+        free(movie);
+        return NULL;
+    }
+    return movie;
+}
+
+// Start recording a run that has just been set up
+movie_t *movie_record(const char *path, const chip8_t *chip8,
+                      const uint8_t *rom, size_t size) {
+    movie_t *movie = open_movie(path, "wb");
+    if (!movie)
+        return NULL;
+
+    movie_header_t header = {.version = MOVIE_VERSION,
+                             .profile = chip8->profile,
+                             .display_wait = chip8->quirks.display_wait};
+    memcpy(header.magic, MOVIE_MAGIC, sizeof(header.magic));
+    header.ipf[0] = chip8->ipf & 0xFF;
+    header.ipf[1] = chip8->ipf >> 8;
+    for (int i = 0; i < 4; i++) {
+        header.seed[i] = chip8->rng >> (i * 8);
+    }
+    sha1(rom, size, header.sha1);
+
+    if (fwrite(&header, sizeof(header), 1, movie->fp) != 1) {
+        fprintf(stderr, "Error: Could not write movie %s\n", path);
+        movie_close(movie);
+        return NULL;
+    }
+    return movie;
+}
+
+// Set a run up as recorded. The loaded ROM must be the one recorded.
+movie_t *movie_replay(const char *path, chip8_t *chip8, const uint8_t *rom,
+                      size_t size) {
+    movie_t *movie = open_movie(path, "rb");
+    if (!movie)
+        return NULL;
+    movie->replaying = true;
+
+    movie_header_t header;
+    uint8_t digest[SHA1_SIZE];
+    sha1(rom, size, digest);
+    if (fread(&header, sizeof(header), 1, movie->fp) != 1 ||
+        memcmp(header.magic, MOVIE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != MOVIE_VERSION || header.profile >= PROFILE_COUNT ||
+        header.display_wait > 1 || (header.ipf[0] | header.ipf[1]) == 0) {
+        fprintf(stderr, "Error: Invalid movie %s\n", path);
+        movie_close(movie);
+        return NULL;
+    }
+    if (memcmp(header.sha1, digest, SHA1_SIZE) != 0) {
+        fprintf(stderr, "Error: Movie %s was recorded with another ROM\n",
+                path);
+        movie_close(movie);
+        return NULL;
+    }
+
+    set_profile(chip8, (profile_t)header.profile);
+    chip8->quirks.display_wait = header.display_wait;
+    chip8->ipf = header.ipf[0] | header.ipf[1] << 8;
+    seed_rng(chip8, header.seed[0] | header.seed[1] << 8 |
+                        header.seed[2] << 16 | (uint32_t)header.seed[3] << 24);
+    return movie;
+}
+
+static void write_run(movie_t *movie) {
+    uint8_t run[4] = {movie->keys & 0xFF, movie->keys >> 8, movie->run & 0xFF,
+                      movie->run >> 8};
+    fwrite(run, sizeof(run), 1, movie->fp);
+    movie->run = 0;
+}
+
+// Call once per frame, before emulating it. Records the keypad, or
+// replaces it with the recorded one. Returns false once a replay is over.
+bool movie_frame(movie_t *movie, chip8_t *chip8) {
+    if (!movie->replaying) {
+        uint16_t keys = pack_keypad(chip8);
+        bool full = movie->run == MOVIE_MAX_RUN;
+        if (movie->run > 0 && (keys != movie->keys || full))
+            write_run(movie);
+        movie->keys = keys;
+        movie->run++;
+        return true;
+    }
+
+    uint8_t run[4];
+    while (movie->run == 0) {
+        if (fread(run, sizeof(run), 1, movie->fp) != 1)
+            return false;
+        movie->keys = run[0] | run[1] << 8;
+        movie->run = run[2] | run[3] << 8;
+    }
+
+    for (int i = 0; i < 16; i++) {
+        chip8->keypad[i] = (movie->keys >> i) & 1;
+    }
+    movie->run--;
+    return true;
+}
+
+void movie_close(movie_t *movie) {
+    if (!movie->replaying && movie->run > 0)
+        write_run(movie);
+    fclose(movie->fp);
+    free(movie);
+}
@@ -0,0 +1,41 @@
+/*
+Input movies. The keypad is recorded once per frame, as runs of identical
+keypad states, behind a header holding everything else a run depends on:
+the ROM's SHA-1, the RNG seed, the profile and its runtime settings.
+Replaying one reproduces the original run exactly.
+*/
+
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+#include "romdb.h"
+
+#define MOVIE_MAGIC "C8MV"
+#define MOVIE_VERSION 1
+
+// File header, followed by 4 byte runs: keypad bits, then frame count,
+// both 16 bit little endian
+typedef struct {
+    char magic[4];         // MOVIE_MAGIC
+    uint8_t version;       // MOVIE_VERSION
+    uint8_t profile;       // profile_t
+    uint8_t display_wait;  // Display wait quirk
+    uint8_t reserved;
+    uint8_t ipf[2];        // Instructions per frame, little endian
+    uint8_t seed[4];       // RNG seed, little endian
+    uint8_t sha1[SHA1_SIZE];
+} movie_header_t;
+
+movie_t *movie_record(const char *path, const chip8_t *chip8,
+                      const uint8_t *rom, size_t size);
+movie_t *movie_replay(const char *path, chip8_t *chip8, const uint8_t *rom,
+                      size_t size);
+bool movie_frame(movie_t *movie, chip8_t *chip8);
+void movie_close(movie_t *movie);
+
+#endif /* MOVIE_H */
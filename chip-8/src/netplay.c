@@ -0,0 +1,426 @@
+#include "netplay.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "romdb.h"
+#include "savestate.h"
+
+#if defined(_WIN32) || defined(__EMSCRIPTEN__)
+
+// Only BSD sockets are supported
+netplay_t *netplay_open(int port, const char *peer, const chip8_t *chip8,
+                        const uint8_t *rom, size_t size,
+                        const netplay_faults_t *faults) {
+    (void)port, (void)peer, (void)chip8, (void)rom, (void)size, (void)faults;
+    fprintf(stderr, "Error: Netplay is not supported on this platform\n");
+    return NULL;
+}
+
+bool netplay_frame(netplay_t *net, chip8_t *chip8) {
+    (void)net, (void)chip8;
+    return false;
+}
+
+bool netplay_poll(netplay_t *net) {
+    (void)net;
+    return false;
+}
+
+int netplay_rollbacks(const netplay_t *net) {
+    (void)net;
+    return 0;
+}
+
+void netplay_close(netplay_t *net) {
+    (void)net;
+}
+
+#else
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define NETPLAY_INPUTS 32   // Frames of input kept, a power of two
+#define NETPLAY_QUEUE 256   // Packets held back by the delay fault
+#define NETPLAY_PACKET 128  // Largest packet
+
+#define PACKET_HELLO 0  // Settings and seed, until both peers have them
+#define PACKET_INPUT 1  // Keypad of consecutive frames
+
+// Bytes of each packet before its variable part
+#define HELLO_SIZE (4 + 1 + 1 + 1 + 1 + 1 + 2 + 4 + SHA1_SIZE)
+#define INPUT_HEADER_SIZE (4 + 1 + 1 + 4 + 4)
+
+typedef struct {
+    uint32_t due;  // SDL_GetTicks time to send at
+    size_t size;
+    uint8_t data[NETPLAY_PACKET];
+} pending_packet_t;
+
+struct netplay {
+    int fd;
+    struct sockaddr_in peer;
+    netplay_faults_t faults;
+    pending_packet_t pending[NETPLAY_QUEUE];  // Oldest first
+    int pending_count;
+
+    uint8_t hello[HELLO_SIZE];  // Our settings, sent until connected
+    bool have_hello;            // The peer's settings arrived
+    bool peer_ready;            // The peer has our settings
+    uint32_t seed;              // Our half of the shared RNG seed
+    uint32_t peer_seed;
+    bool connected;
+    uint32_t heard;  // SDL_GetTicks time the peer was last heard from
+
+    uint32_t frame;         // Next frame to run
+    uint32_t remote_count;  // Frames whose remote input has arrived
+    uint32_t peer_ack;      // Frames of our input the peer has
+    bool mispredicted;      // A frame since `rollback` was run on bad input
+    uint32_t rollback;      // Oldest frame to run again
+    int rollbacks;          // Frames run again in total
+
+    uint16_t local[NETPLAY_INPUTS];
+    uint16_t remote[NETPLAY_INPUTS];
+    uint16_t predicted[NETPLAY_INPUTS];  // Remote input each frame ran with
+    uint8_t states[NETPLAY_MAX_ROLLBACK + 1][SAVESTATE_SIZE];  // Frame starts
+};
+
+static void put32(uint8_t *out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = value >> (i * 8);
+    }
+}
+
+static uint32_t get32(const uint8_t *in) {
+    return in[0] | in[1] << 8 | in[2] << 16 | (uint32_t)in[3] << 24;
+}
+
+static uint16_t pack_keypad(const chip8_t *chip8) {
+    uint16_t keys = 0;
+    for (int i = 0; i < 16; i++) {
+        keys |= chip8->keypad[i] << i;
+    }
+    return keys;
+}
+
+static void unpack_keypad(chip8_t *chip8, uint16_t keys) {
+    for (int i = 0; i < 16; i++) {
+        chip8->keypad[i] = (keys >> i) & 1;
+    }
+}
+
+static bool resolve_peer(const char *peer, struct sockaddr_in *addr) {
+    char host[256];
+    const char *colon = strrchr(peer, ':');
+    if (!colon || colon == peer || (size_t)(colon - peer) >= sizeof(host))
+        return false;
+    memcpy(host, peer, colon - peer);
+    host[colon - peer] = '\0';
+
+    struct addrinfo hints = {0};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    struct addrinfo *result;
+    if (getaddrinfo(host, colon + 1, &hints, &result) != 0)
+        return false;
+
+    memcpy(addr, result->ai_addr, sizeof(*addr));
+    freeaddrinfo(result);
+    return true;
+}
+
+// Connect to a peer, given as host:port. Both peers must have loaded the
+// same ROM with the same settings.
+netplay_t *netplay_open(int port, const char *peer, const chip8_t *chip8,
+                        const uint8_t *rom, size_t size,
+                        const netplay_faults_t *faults) {
+    netplay_t *net = calloc(1, sizeof(*net));
+    if (!net) {
+        fprintf(stderr, "Error: Could not allocate netplay session\n");
+        return NULL;
+    }
+    net->faults = *faults;
+
+    if (!resolve_peer(peer, &net->peer)) {
+        fprintf(stderr, "Error: Could not resolve peer %s\n", peer);
+        free(net);
+        return NULL;
+    }
+
+    struct sockaddr_in local = {0};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(port);
+    net->fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (net->fd == -1 ||
+        bind(net->fd, (struct sockaddr *)&local, sizeof(local)) != 0 ||
+        fcntl(net->fd, F_SETFL, O_NONBLOCK) != 0) {
+        fprintf(stderr, "Error: Could not open UDP port %d\n", port);
+        if (net->fd != -1)
+            close(net->fd);
+        free(net);
+        return NULL;
+    }
+
+    // The shared seed combines both peers' own, so neither has to lead
+    net->seed = chip8->rng;
+    uint8_t *hello = net->hello;
+    memcpy(hello, NETPLAY_MAGIC, 4);
+    hello[4] = PACKET_HELLO;
+    hello[5] = NETPLAY_VERSION;
+    hello[7] = chip8->profile;
+    hello[8] = chip8->quirks.display_wait;
+    hello[9] = chip8->ipf & 0xFF;
+    hello[10] = chip8->ipf >> 8;
+    put32(&hello[11], net->seed);
+    sha1(rom, size, &hello[15]);
+
+    return net;
+}
+
+// Send a packet, subject to the configured faults
+static void send_packet(netplay_t *net, const uint8_t *data, size_t size) {
+    if (net->faults.loss > 0 && rand() % 100 < net->faults.loss)
+        return;
+
+    if (net->faults.delay_ms == 0) {
+        sendto(net->fd, data, size, 0, (struct sockaddr *)&net->peer,
+               sizeof(net->peer));
+        return;
+    }
+
+    if (net->pending_count == NETPLAY_QUEUE)
+        return;
+    pending_packet_t *packet = &net->pending[net->pending_count++];
+    packet->due = SDL_GetTicks() + net->faults.delay_ms;
+    packet->size = size;
+    memcpy(packet->data, data, size);
+}
+
+// Send the delayed packets whose time has come
+static void flush_pending(netplay_t *net) {
+    uint32_t now = SDL_GetTicks();
+    int sent = 0;
+    while (sent < net->pending_count &&
+           (int32_t)(now - net->pending[sent].due) >= 0) {
+        const pending_packet_t *packet = &net->pending[sent++];
+        sendto(net->fd, packet->data, packet->size, 0,
+               (struct sockaddr *)&net->peer, sizeof(net->peer));
+    }
+
+    net->pending_count -= sent;
+    memmove(net->pending, &net->pending[sent],
+            net->pending_count * sizeof(pending_packet_t));
+}
+
+static void send_hello(netplay_t *net) {
+    net->hello[6] = net->have_hello;  // Tells the peer it may start
+    send_packet(net, net->hello, sizeof(net->hello));
+}
+
+// Send our input for every frame the peer hasn't acknowledged
+static void send_inputs(netplay_t *net) {
+    uint32_t first = net->peer_ack;
+    if (net->frame - first > NETPLAY_INPUTS)
+        first = net->frame - NETPLAY_INPUTS;
+    uint32_t count = net->frame - first;
+
+    uint8_t packet[NETPLAY_PACKET];
+    memcpy(packet, NETPLAY_MAGIC, 4);
+    packet[4] = PACKET_INPUT;
+    packet[5] = count;
+    put32(&packet[6], net->remote_count);
+    put32(&packet[10], first);
+    for (uint32_t i = 0; i < count; i++) {
+        uint16_t keys = net->local[(first + i) % NETPLAY_INPUTS];
+        packet[INPUT_HEADER_SIZE + i * 2] = keys & 0xFF;
+        packet[INPUT_HEADER_SIZE + i * 2 + 1] = keys >> 8;
+    }
+    send_packet(net, packet, INPUT_HEADER_SIZE + count * 2);
+}
+
+static bool receive_hello(netplay_t *net, const uint8_t *packet,
+                          size_t size) {
+    // Everything but the ready flag and seed has to match
+    if (size != HELLO_SIZE || memcmp(&packet[7], &net->hello[7], 4) != 0 ||
+        memcmp(&packet[15], &net->hello[15], SHA1_SIZE) != 0 ||
+        packet[5] != NETPLAY_VERSION) {
+        fprintf(stderr, "Error: Peer runs a different ROM or settings\n");
+        return false;
+    }
+
+    net->peer_seed = get32(&packet[11]);
+    net->have_hello = true;
+    net->peer_ready = net->peer_ready || packet[6];
+    return true;
+}
+
+// Take in the remote input that follows what is known. Inputs are always
+// sent from the last acknowledged frame, so nothing arrives with a gap.
+static void receive_inputs(netplay_t *net, const uint8_t *packet,
+                           size_t size) {
+    uint32_t count = packet[5];
+    if (size != INPUT_HEADER_SIZE + count * 2)
+        return;
+
+    net->peer_ready = true;  // The peer only sends input once it has started
+    uint32_t ack = get32(&packet[6]);
+    if (ack > net->peer_ack)
+        net->peer_ack = ack;
+
+    uint32_t first = get32(&packet[10]);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t frame = first + i;
+        if (frame != net->remote_count)
+            continue;
+
+        const uint8_t *keys = &packet[INPUT_HEADER_SIZE + i * 2];
+        uint16_t remote = keys[0] | keys[1] << 8;
+        net->remote[frame % NETPLAY_INPUTS] = remote;
+        net->remote_count++;
+
+        bool wrong = remote != net->predicted[frame % NETPLAY_INPUTS];
+        if (frame < net->frame && wrong && !net->mispredicted) {
+            net->mispredicted = true;
+            net->rollback = frame;
+        }
+    }
+}
+
+// Read every packet waiting. Returns false if the peer can't be played.
+static bool receive(netplay_t *net) {
+    uint8_t packet[NETPLAY_PACKET];
+    struct sockaddr_in from;
+    socklen_t from_size = sizeof(from);
+    ssize_t size;
+
+    while ((size = recvfrom(net->fd, packet, sizeof(packet), 0,
+                            (struct sockaddr *)&from, &from_size)) >= 0) {
+        from_size = sizeof(from);
+        if (from.sin_addr.s_addr != net->peer.sin_addr.s_addr ||
+            from.sin_port != net->peer.sin_port || size < 5 ||
+            memcmp(packet, NETPLAY_MAGIC, 4) != 0)
+            continue;
+
+        net->heard = SDL_GetTicks();
+        if (packet[4] == PACKET_HELLO) {
+            if (!receive_hello(net, packet, size))
+                return false;
+        } else if (packet[4] == PACKET_INPUT) {
+            receive_inputs(net, packet, size);
+        }
+    }
+
+    // Waiting for a peer to join has no limit, but a session does
+    if (net->connected && SDL_GetTicks() - net->heard > NETPLAY_TIMEOUT_MS) {
+        fprintf(stderr, "Error: Peer stopped responding\n");
+        return false;
+    }
+    return true;
+}
+
+// Remote input for a frame: the real one when it has arrived, otherwise
+// the last one known, as keys tend to stay held
+static uint16_t remote_input(netplay_t *net, uint32_t frame) {
+    uint16_t keys = 0;
+    if (frame < net->remote_count) {
+        keys = net->remote[frame % NETPLAY_INPUTS];
+    } else if (net->remote_count > 0) {
+        keys = net->remote[(net->remote_count - 1) % NETPLAY_INPUTS];
+    }
+    net->predicted[frame % NETPLAY_INPUTS] = keys;
+    return keys;
+}
+
+// Save the state at the start of a frame and run it with both inputs
+static void run_frame(netplay_t *net, chip8_t *chip8, uint32_t frame) {
+    uint8_t *state = net->states[frame % (NETPLAY_MAX_ROLLBACK + 1)];
+    chip8_save_state(chip8, state, SAVESTATE_SIZE);
+
+    unpack_keypad(chip8, net->local[frame % NETPLAY_INPUTS] |
+                             remote_input(net, frame));
+    emulate_frame(chip8);
+}
+
+// Go back to the oldest mispredicted frame and run every frame since again
+static void roll_back(netplay_t *net, chip8_t *chip8) {
+    uint8_t *state = net->states[net->rollback % (NETPLAY_MAX_ROLLBACK + 1)];
+    chip8_load_state(chip8, state, SAVESTATE_SIZE);
+
+    for (uint32_t frame = net->rollback; frame < net->frame; frame++) {
+        run_frame(net, chip8, frame);
+        tick_timers(chip8);
+    }
+    net->rollbacks += net->frame - net->rollback;
+    net->mispredicted = false;
+}
+
+// Run the next frame in place of emulate_frame, with the local keypad as
+// this peer's input. Returns false without running it while connecting or
+// while too far ahead of the peer's input to keep predicting.
+bool netplay_frame(netplay_t *net, chip8_t *chip8) {
+    flush_pending(net);
+    if (!receive(net)) {
+        chip8->state = QUIT;
+        return false;
+    }
+
+    if (!net->connected) {
+        send_hello(net);
+        if (!net->have_hello || !net->peer_ready)
+            return false;
+        seed_rng(chip8, net->seed ^ net->peer_seed);
+        net->connected = true;
+        net->heard = SDL_GetTicks();
+    }
+
+    // The emulated keypad holds both inputs only while frames run
+    uint16_t local = pack_keypad(chip8);
+    if (net->mispredicted)
+        roll_back(net, chip8);
+
+    // The peer's input may be ahead of this peer, which never waits then
+    if (net->frame >= net->remote_count + NETPLAY_MAX_ROLLBACK) {
+        unpack_keypad(chip8, local);
+        send_inputs(net);
+        return false;
+    }
+
+    net->local[net->frame % NETPLAY_INPUTS] = local;
+    net->frame++;
+    send_inputs(net);
+    run_frame(net, chip8, net->frame - 1);
+    unpack_keypad(chip8, local);
+    return true;
+}
+
+// Keep the session going without running a frame, so the peer isn't left
+// waiting on input or packets held back here
+bool netplay_poll(netplay_t *net) {
+    flush_pending(net);
+    if (!receive(net))
+        return false;
+    if (net->connected)
+        send_inputs(net);
+    return true;
+}
+
+int netplay_rollbacks(const netplay_t *net) {
+    return net->rollbacks;
+}
+
+void netplay_close(netplay_t *net) {
+    close(net->fd);
+    free(net);
+}
+
+#endif
@@ -0,0 +1,39 @@
+/*
+Rollback netplay for two players. Both peers run the whole emulation and
+send each other their keypad every frame over UDP; the emulated keypad is
+the two combined, as two player games give each player their own keys.
+Frames whose remote input hasn't arrived are run on a prediction, the
+peer's last known keys, and when the real input turns out different those
+frames are run again from a save state.
+*/
+
+#ifndef NETPLAY_H
+#define NETPLAY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+#define NETPLAY_MAGIC "C8NP"
+#define NETPLAY_VERSION 1
+#define NETPLAY_PORT 6502        // Default local port
+#define NETPLAY_MAX_ROLLBACK 8   // Frames run ahead of the peer's input
+#define NETPLAY_TIMEOUT_MS 5000  // Silence after which the peer is gone
+
+// Faults added to every packet sent, for testing on a local network
+typedef struct {
+    int delay_ms;  // Latency added to each packet
+    int loss;      // Percentage of packets dropped
+} netplay_faults_t;
+
+netplay_t *netplay_open(int port, const char *peer, const chip8_t *chip8,
+                        const uint8_t *rom, size_t size,
+                        const netplay_faults_t *faults);
+bool netplay_frame(netplay_t *net, chip8_t *chip8);
+bool netplay_poll(netplay_t *net);
+int netplay_rollbacks(const netplay_t *net);
+void netplay_close(netplay_t *net);
+
+#endif /* NETPLAY_H */
@@ -0,0 +1,22 @@
+#include "profile.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+static const char *profile_names[PROFILE_COUNT] = {
+    [PROFILE_VIP] = "vip",
+    [PROFILE_SCHIP_LEGACY] = "schip",
+    [PROFILE_SCHIP_MODERN] = "schip-modern",
+    [PROFILE_XOCHIP] = "xochip",
+};
+
+bool parse_profile(const char *name, profile_t *profile) {
+    for (int i = 0; i < PROFILE_COUNT; i++) {
+        if (strcmp(name, profile_names[i]) == 0) {
+            *profile = (profile_t)i;
+            return true;
+        }
+    }
+
+    return false;
+}
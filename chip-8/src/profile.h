@@ -0,0 +1,22 @@
+/*
+Platforms whose behaviour can be emulated, and their names on the command
+line and in the ROM database source. Kept free of SDL so the ROM database
+tool can link it on its own.
+*/
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>
+
+typedef enum {
+    PROFILE_VIP,           // COSMAC VIP
+    PROFILE_SCHIP_LEGACY,  // SUPER-CHIP 1.1 on the HP48
+    PROFILE_SCHIP_MODERN,  // SUPER-CHIP as implemented by modern interpreters
+    PROFILE_XOCHIP,        // XO-CHIP
+    PROFILE_COUNT
+} profile_t;
+
+bool parse_profile(const char *name, profile_t *profile);
+
+#endif /* PROFILE_H */
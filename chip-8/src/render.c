@@ -0,0 +1,234 @@
+#include <SDL.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "chip8.h"
+
+// ARGB8888 colors by palette index (plane 1 bit | plane 2 bit << 1). The
+// background is transparent so persistence can blend frames over it.
+static const uint32_t palette[1 << DISPLAY_PLANES] = {
+    0x00000000,  // Background
+    0xFFFFFFFF,  // Plane 1
+    0xFFAAAAAA,  // Plane 2
+    0xFF555555,  // Both planes
+};
+
+void init_frame_buffer(frame_buffer_t *fb) {
+    memset(fb->frames, 0, sizeof(fb->frames));
+    init_triple_buffer(&fb->slots);
+}
+
+// Number of frames a fully lit pixel takes to decay to black. Each frame
+// keeps persistence/255 of the brightness, so below 255 the level drops by
+// at least one every frame. At 255 nothing ever decays, and the count
+// stops at the same bound.
+int fade_length(uint8_t persistence) {
+    int frames = 0;
+    for (int level = 255; level > 0 && frames < 255;
+         level = level * persistence / 255) {
+        frames++;
+    }
+    return frames;
+}
+
+static void clear_persistence(sdl_t *sdl) {
+    SDL_SetRenderTarget(sdl->renderer, sdl->persist_texture);
+    SDL_SetRenderDrawColor(sdl->renderer, 0, 0, 0, SDL_ALPHA_OPAQUE);
+    SDL_RenderClear(sdl->renderer);
+    SDL_SetRenderTarget(sdl->renderer, NULL);
+}
+
+// Create the renderer and the textures it draws from
+static bool create_renderer(sdl_t *sdl) {
+    sdl->renderer = SDL_CreateRenderer(
+        sdl->window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_TARGETTEXTURE);
+    if (sdl->renderer == NULL)
+        return false;
+
+    sdl->texture = SDL_CreateTexture(sdl->renderer, SDL_PIXELFORMAT_ARGB8888,
+                                     SDL_TEXTUREACCESS_STREAMING,
+                                     DISPLAY_MAX_WIDTH, DISPLAY_MAX_HEIGHT);
+    if (sdl->texture == NULL)
+        return false;
+    SDL_SetTextureBlendMode(sdl->texture, SDL_BLENDMODE_NONE);
+
+    // The GPU scales the display to the window by whole multiples
+    sdl->width = LORES_WIDTH;
+    sdl->height = LORES_HEIGHT;
+    SDL_RenderSetLogicalSize(sdl->renderer, sdl->width, sdl->height);
+    SDL_RenderSetIntegerScale(sdl->renderer, SDL_TRUE);
+
+    if (sdl->persistence == 0)
+        return true;
+
+    // Phosphor persistence: every frame the accumulated image is darkened
+    // by a translucent black fill and the new frame is blended on top, all
+    // on the GPU
+    sdl->persist_texture = SDL_CreateTexture(
+        sdl->renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET,
+        DISPLAY_MAX_WIDTH, DISPLAY_MAX_HEIGHT);
+    if (sdl->persist_texture == NULL) {
+        printf("Persistence disabled, no render targets: %s\n",
+               SDL_GetError());
+        sdl->persistence = 0;
+        return true;
+    }
+
+    SDL_SetTextureBlendMode(sdl->texture, SDL_BLENDMODE_BLEND);
+    clear_persistence(sdl);
+
+    sdl->fade_frames = fade_length(sdl->persistence);
+    return true;
+}
+
+static void destroy_renderer(sdl_t *sdl) {
+    if (sdl->persist_texture)
+        SDL_DestroyTexture(sdl->persist_texture);
+    if (sdl->texture)
+        SDL_DestroyTexture(sdl->texture);
+    if (sdl->renderer)
+        SDL_DestroyRenderer(sdl->renderer);
+    sdl->persist_texture = NULL;
+    sdl->texture = NULL;
+    sdl->renderer = NULL;
+}
+
+// Draw the current texture contents to the window. No CPU-side pixel work
+// happens here, so it can be repeated while the phosphor image decays.
+static void present_display(sdl_t *sdl) {
+    SDL_Texture *source = sdl->texture;
+    SDL_Rect area = {.x = 0, .y = 0, .w = sdl->width, .h = sdl->height};
+
+    if (sdl->persist_texture) {
+        SDL_SetRenderTarget(sdl->renderer, sdl->persist_texture);
+        SDL_SetRenderDrawBlendMode(sdl->renderer, SDL_BLENDMODE_BLEND);
+        SDL_SetRenderDrawColor(sdl->renderer, 0, 0, 0,
+                               SDL_ALPHA_OPAQUE - sdl->persistence);
+        SDL_RenderFillRect(sdl->renderer, &area);
+        SDL_RenderCopy(sdl->renderer, sdl->texture, &area, &area);
+        SDL_SetRenderTarget(sdl->renderer, NULL);
+        source = sdl->persist_texture;
+    }
+
+    // Clear the letterbox borders left by integer scaling
+    SDL_SetRenderDrawColor(sdl->renderer, 0, 0, 0, SDL_ALPHA_OPAQUE);
+    SDL_RenderClear(sdl->renderer);
+    SDL_RenderCopy(sdl->renderer, source, &area, NULL);
+    SDL_RenderPresent(sdl->renderer);
+}
+
+// Keep decaying the phosphor image while no new frames arrive
+static void refresh_display(sdl_t *sdl) {
+    if (sdl->fade_left > 0) {
+        sdl->fade_left--;
+        present_display(sdl);
+    }
+}
+
+void update_display(sdl_t *sdl, const frame_t *frame) {
+    uint32_t pixels[DISPLAY_MAX_WIDTH * DISPLAY_MAX_HEIGHT];
+
+    // The logical size follows the resolution so both modes fill the window
+    if (frame->width != sdl->width || frame->height != sdl->height) {
+        sdl->width = frame->width;
+        sdl->height = frame->height;
+        SDL_RenderSetLogicalSize(sdl->renderer, sdl->width, sdl->height);
+        if (sdl->persist_texture)
+            clear_persistence(sdl);
+    }
+
+    uint32_t *pixel = pixels;
+    for (int y = 0; y < frame->height; y++) {
+        for (int x = 0; x < frame->width; x++) {
+            *pixel++ = palette[get_color(frame->planes, x, y)];
+        }
+    }
+
+    SDL_Rect area = {.x = 0, .y = 0, .w = frame->width, .h = frame->height};
+    SDL_UpdateTexture(sdl->texture, &area, pixels,
+                      frame->width * sizeof(pixels[0]));
+    sdl->fade_left = sdl->fade_frames;
+    present_display(sdl);
+}
+
+// Show the newest frame if one was published, otherwise keep decaying the
+// phosphor image on each `tick`. Runs on the thread that owns the renderer.
+void present_frames(sdl_t *sdl, bool tick) {
+    SDL_AtomicSet(&sdl->frame_pending, 0);
+    if (swap_front(&sdl->frames.slots)) {
+        update_display(sdl, &sdl->frames.frames[sdl->frames.slots.front]);
+    } else if (tick) {
+        refresh_display(sdl);
+    }
+}
+
+// Handle events and present frames until the emulation thread ends. The
+// window, renderer and events all stay on the main thread, which is the
+// only one SDL supports them on everywhere.
+void run_display(sdl_t *sdl) {
+    while (SDL_AtomicGet(&sdl->emulating)) {
+        SDL_Event event;
+        int wait = sdl->fade_left ? FADE_WAIT_MS : RENDER_WAIT_MS;
+        bool woken = SDL_WaitEventTimeout(&event, wait);
+        if (woken) {
+            handle_event(sdl, &event);
+            handle_input(sdl);
+        }
+        present_frames(sdl, !woken);
+    }
+}
+
+bool open_display(sdl_t *sdl) {
+    init_frame_buffer(&sdl->frames);
+    sdl->wake_event = SDL_RegisterEvents(1);
+    if (!create_renderer(sdl)) {
+        printf("Could not initialize SDL_Renderer: %s\n", SDL_GetError());
+        destroy_renderer(sdl);
+        return false;
+    }
+    return true;
+}
+
+void close_display(sdl_t *sdl) {
+    destroy_renderer(sdl);
+}
+
+// Wake the display loop, once for any number of frames published before it
+// gets to them
+void wake_display(sdl_t *sdl) {
+    if (!sdl->threaded || !SDL_AtomicCAS(&sdl->frame_pending, 0, 1))
+        return;
+
+    SDL_Event event;
+    memset(&event, 0, sizeof(event));
+    event.type = sdl->wake_event;
+    SDL_PushEvent(&event);
+}
+
+void publish_frame(chip8_t *chip8) {
+    sdl_t *sdl = &chip8->sdl;
+    frame_buffer_t *fb = &sdl->frames;
+
+    frame_t *frame = &fb->frames[fb->slots.back];
+    frame->width = chip8->display_width;
+    frame->height = chip8->display_height;
+    memcpy(frame->planes, chip8->display, sizeof(chip8->display));
+    swap_back(&fb->slots);
+    wake_display(sdl);
+}
+
+// Recompute the scaled viewport and redraw after the window is resized.
+// Called from the event loop, on the thread that owns the renderer.
+void resize_display(sdl_t *sdl) {
+    SDL_RenderSetLogicalSize(sdl->renderer, sdl->width, sdl->height);
+    present_display(sdl);
+}
+
+// Some backends, Direct3D among them, lose the contents of render targets
+// on a resize or device change. The phosphor image then starts over from
+// the current frame.
+void reset_display(sdl_t *sdl) {
+    if (sdl->persist_texture)
+        clear_persistence(sdl);
+    present_display(sdl);
+}
@@ -0,0 +1,237 @@
+#include "rewind.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "savestate.h"
+
+// Worst case encoding: a one byte skip and count around every lone byte,
+// plus a run split at every memory page boundary
+#define DELTA_MAX_SIZE (SAVESTATE_PAYLOAD * 3 / 2 + MEMORY_PAGES * 8 + 16)
+
+// Where a delta lives in the data ring
+typedef struct {
+    size_t offset;
+    size_t length;
+} rewind_entry_t;
+
+struct rewind_buffer {
+    uint8_t *data;            // Encoded deltas, used as a ring
+    size_t capacity;          // Memory budget in bytes
+    size_t head;              // End of the newest delta
+    rewind_entry_t *entries;  // Deltas, oldest first, as a ring
+    int max_entries;          // Frames of history at most
+    int first;                // Oldest delta
+    int count;                // Deltas held
+    bool primed;              // `current` holds a state
+    uint8_t current[SAVESTATE_PAYLOAD];  // Newest state
+    uint8_t scratch[DELTA_MAX_SIZE];     // Delta being encoded
+};
+
+static size_t put_varint(uint8_t *out, size_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    out[n++] = value;
+    return n;
+}
+
+static size_t get_varint(const uint8_t *in, size_t *value) {
+    size_t n = 0;
+    int shift = 0;
+    *value = 0;
+    do {
+        *value |= (size_t)(in[n] & 0x7F) << shift;
+        shift += 7;
+    } while (in[n++] & 0x80);
+    return n;
+}
+
+// Delta being encoded as runs of a zero byte count, a literal byte count
+// and the literal bytes
+typedef struct {
+    uint8_t *out;
+    size_t length;
+    size_t skip;  // Equal bytes not yet written
+} delta_writer_t;
+
+// Encode `a` XOR `b` over [from, to)
+static void diff_range(delta_writer_t *writer, const uint8_t *a,
+                       const uint8_t *b, size_t from, size_t to) {
+    size_t i = from;
+    while (i < to) {
+        size_t start = i;
+        while (i < to && a[i] == b[i]) {
+            i++;
+        }
+        writer->skip += i - start;
+
+        start = i;
+        while (i < to && a[i] != b[i]) {
+            i++;
+        }
+        if (i == start)
+            continue;
+
+        uint8_t *out = writer->out;
+        writer->length += put_varint(&out[writer->length], writer->skip);
+        writer->length += put_varint(&out[writer->length], i - start);
+        for (size_t j = start; j < i; j++) {
+            out[writer->length++] = a[j] ^ b[j];
+        }
+        writer->skip = 0;
+    }
+}
+
+// Encode the delta between a state and the previous one. Clean pages are
+// known to be unchanged, so they are skipped outright.
+static size_t encode_delta(const chip8_t *chip8, const uint8_t *previous,
+                           uint8_t *out) {
+    const uint8_t *state = (const uint8_t *)chip8;
+    delta_writer_t writer = {out, 0, 0};
+
+    diff_range(&writer, state, previous, 0, MEMORY_OFFSET);
+    for (int page = 0; page < MEMORY_PAGES; page++) {
+        size_t from = MEMORY_OFFSET + page * MEMORY_PAGE_SIZE;
+        if (is_page_dirty(chip8, DIRTY_REWIND, page)) {
+            diff_range(&writer, state, previous, from,
+                       from + MEMORY_PAGE_SIZE);
+        } else {
+            writer.skip += MEMORY_PAGE_SIZE;
+        }
+    }
+    diff_range(&writer, state, previous, MEMORY_OFFSET + MEMORY_SIZE,
+               SAVESTATE_PAYLOAD);
+
+    return writer.length;
+}
+
+// XOR an encoded delta into `state`
+static void apply_delta(uint8_t *state, const uint8_t *in, size_t length) {
+    size_t n = 0;
+    size_t i = 0;
+    while (n < length) {
+        size_t skip, literal;
+        n += get_varint(&in[n], &skip);
+        n += get_varint(&in[n], &literal);
+        i += skip;
+        for (size_t j = 0; j < literal; j++) {
+            state[i++] ^= in[n++];
+        }
+    }
+}
+
+rewind_buffer_t *rewind_open(int seconds, size_t budget) {
+    rewind_buffer_t *buffer = calloc(1, sizeof(*buffer));
+    if (!buffer) {
+        fprintf(stderr, "Error: Could not allocate rewind buffer\n");
+        return NULL;
+    }
+
+    buffer->capacity = budget;
+    buffer->max_entries = seconds * 60;
+    buffer->data = malloc(budget);
+    buffer->entries = malloc(buffer->max_entries * sizeof(rewind_entry_t));
+    if (!buffer->data || !buffer->entries) {
+        fprintf(stderr, "Error: Could not allocate rewind buffer\n");
+        rewind_close(buffer);
+        return NULL;
+    }
+
+    return buffer;
+}
+
+static void drop_oldest(rewind_buffer_t *buffer) {
+    buffer->first = (buffer->first + 1) % buffer->max_entries;
+    buffer->count--;
+}
+
+// Record the state at the end of a frame. Only the memory pages written
+// since the last push are compared and copied.
+void rewind_push(rewind_buffer_t *buffer, chip8_t *chip8) {
+    const uint8_t *state = (const uint8_t *)chip8;
+    if (!buffer->primed) {
+        memcpy(buffer->current, state, SAVESTATE_PAYLOAD);
+        buffer->primed = true;
+        clear_dirty_pages(chip8, DIRTY_REWIND);
+        return;
+    }
+
+    size_t length = encode_delta(chip8, buffer->current, buffer->scratch);
+    memcpy(buffer->current, state, MEMORY_OFFSET);
+    for (int page = 0; page < MEMORY_PAGES; page++) {
+        size_t from = MEMORY_OFFSET + page * MEMORY_PAGE_SIZE;
+        if (is_page_dirty(chip8, DIRTY_REWIND, page))
+            memcpy(&buffer->current[from], &state[from], MEMORY_PAGE_SIZE);
+    }
+    memcpy(&buffer->current[MEMORY_OFFSET + MEMORY_SIZE],
+           &state[MEMORY_OFFSET + MEMORY_SIZE],
+           SAVESTATE_PAYLOAD - MEMORY_OFFSET - MEMORY_SIZE);
+    clear_dirty_pages(chip8, DIRTY_REWIND);
+
+    // A delta larger than the budget breaks the chain; start over from here
+    if (length > buffer->capacity) {
+        buffer->count = 0;
+        buffer->head = 0;
+        return;
+    }
+
+    // Deltas are kept contiguous, so wrap early when this one doesn't fit.
+    // Everything from the old head to the end is older than what is at 0.
+    size_t offset = buffer->head;
+    bool wrapped = offset + length > buffer->capacity;
+    if (wrapped)
+        offset = 0;
+
+    while (buffer->count > 0) {
+        const rewind_entry_t *oldest = &buffer->entries[buffer->first];
+        bool stale = wrapped && oldest->offset >= buffer->head;
+        bool overlaps = oldest->offset < offset + length &&
+                        offset < oldest->offset + oldest->length;
+        if (!stale && !overlaps && buffer->count < buffer->max_entries)
+            break;
+        drop_oldest(buffer);
+    }
+
+    memcpy(&buffer->data[offset], buffer->scratch, length);
+    int slot = (buffer->first + buffer->count) % buffer->max_entries;
+    buffer->entries[slot] = (rewind_entry_t){offset, length};
+    buffer->count++;
+    buffer->head = offset + length;
+}
+
+// Step back one frame. Returns false when no older state is held. The
+// keypad is live input rather than history, so it is left as it is.
+bool rewind_pop(rewind_buffer_t *buffer, chip8_t *chip8) {
+    if (buffer->count == 0)
+        return false;
+
+    int newest = (buffer->first + buffer->count - 1) % buffer->max_entries;
+    const rewind_entry_t *entry = &buffer->entries[newest];
+    apply_delta(buffer->current, &buffer->data[entry->offset], entry->length);
+    buffer->count--;
+    buffer->head = buffer->count > 0 ? entry->offset : 0;
+
+    bool keypad[sizeof(chip8->keypad)];
+    memcpy(keypad, chip8->keypad, sizeof(keypad));
+    memcpy(chip8, buffer->current, SAVESTATE_PAYLOAD);
+    memcpy(chip8->keypad, keypad, sizeof(keypad));
+    mark_all_dirty(chip8);  // Memory changed behind write_memory's back
+    chip8->draw = true;
+    return true;
+}
+
+int rewind_frames(const rewind_buffer_t *buffer) {
+    return buffer->count;
+}
+
+void rewind_close(rewind_buffer_t *buffer) {
+    free(buffer->data);
+    free(buffer->entries);
+    free(buffer);
+}
@@ -0,0 +1,26 @@
+/*
+Rewind history. Every frame the emulation state is XORed against the
+previous frame's and the result, mostly zeros, is run length encoded into a
+ring buffer of fixed size. Memory pages nobody wrote to are skipped without
+being compared. Stepping back decodes the newest delta into the previous
+state.
+*/
+
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "chip8.h"
+
+#define REWIND_SECONDS 10    // Default history length
+#define REWIND_MEMORY_MB 16  // Default memory budget for the deltas
+
+rewind_buffer_t *rewind_open(int seconds, size_t budget);
+void rewind_push(rewind_buffer_t *buffer, chip8_t *chip8);
+bool rewind_pop(rewind_buffer_t *buffer, chip8_t *chip8);
+int rewind_frames(const rewind_buffer_t *buffer);
+void rewind_close(rewind_buffer_t *buffer);
+
+#endif /* REWIND_H */
@@ -0,0 +1,207 @@
+#include "romdb.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static uint32_t rotl(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+// Hash one 64 byte block into the state
+static void sha1_block(uint32_t state[5], const uint8_t *block) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 |
+               (uint32_t)block[i * 4 + 2] << 8 | block[i * 4 + 3];
+    }
+    for (int i = 16; i < 80; i++) {
+        w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4];
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+
+        uint32_t t = rotl(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rotl(b, 30);
+        b = a;
+        a = t;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+void sha1(const uint8_t *data, size_t size, uint8_t digest[SHA1_SIZE]) {
+    uint32_t state[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476,
+                         0xC3D2E1F0};
+
+    size_t done = 0;
+    for (; size - done >= 64; done += 64) {
+        sha1_block(state, data + done);
+    }
+
+    // Pad the tail with a one bit, zeros and the length in bits
+    uint8_t tail[128] = {0};
+    size_t left = size - done;
+    memcpy(tail, data + done, left);
+    tail[left] = 0x80;
+    size_t tail_size = left < 56 ? 64 : 128;
+    uint64_t bits = (uint64_t)size * 8;
+    for (int i = 0; i < 8; i++) {
+        tail[tail_size - 1 - i] = bits >> (i * 8);
+    }
+
+    for (size_t i = 0; i < tail_size; i += 64) {
+        sha1_block(state, tail + i);
+    }
+
+    for (int i = 0; i < SHA1_SIZE; i++) {
+        digest[i] = state[i / 4] >> (24 - (i % 4) * 8);
+    }
+}
+
+// Binary search a database image for a ROM
+bool lookup_rom(const uint8_t *table, size_t size,
+                const uint8_t digest[SHA1_SIZE], rom_info_t *info) {
+    const romdb_header_t *header = (const romdb_header_t *)table;
+    if (size < sizeof(*header) ||
+        memcmp(header->magic, ROMDB_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != ROMDB_VERSION ||
+        header->record_size != sizeof(rom_record_t)) {
+        fprintf(stderr, "Error: Invalid ROM database\n");
+        return false;
+    }
+
+    const rom_record_t *records =
+        (const rom_record_t *)(table + sizeof(*header));
+    size_t low = 0;
+    size_t high = (size - sizeof(*header)) / sizeof(rom_record_t);
+
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        const rom_record_t *record = &records[mid];
+        int order = memcmp(record->sha1, digest, SHA1_SIZE);
+
+        if (order < 0) {
+            low = mid + 1;
+        } else if (order > 0) {
+            high = mid;
+        } else {
+            if (record->profile >= PROFILE_COUNT)
+                return false;
+
+            info->profile = (profile_t)record->profile;
+            info->display_wait = record->display_wait;
+            info->ipf = record->ipf[0] | record->ipf[1] << 8;
+            for (int i = 0; i < 16; i++) {
+                info->keymap[i] = record->keymap[i];
+            }
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Map the whole database read-only. There is no mmap on Windows, where the
+// table is small enough to simply be read.
+#ifdef _WIN32
+static uint8_t *map_table(const char *db_path, size_t *size) {
+    FILE *fp = fopen(db_path, "rb");
+    if (!fp)
+        return NULL;
+
+    *size = get_rom_size(fp);
+    uint8_t *table = malloc(*size);
+    if (table && fread(table, 1, *size, fp) != *size) {
+        free(table);
+        table = NULL;
+    }
+    fclose(fp);
+    return table;
+}
+
+static void unmap_table(uint8_t *table, size_t size) {
+    (void)size;
+    free(table);
+}
+#else
+static uint8_t *map_table(const char *db_path, size_t *size) {
+    int fd = open(db_path, O_RDONLY);
+    if (fd == -1)
+        return NULL;
+
+    struct stat st;
+    void *table = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        *size = st.st_size;
+        table = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    return table == MAP_FAILED ? NULL : table;
+}
+
+static void unmap_table(uint8_t *table, size_t size) {
+    munmap(table, size);
+}
+#endif
+
+// Look up a ROM image by its SHA-1. A missing database just means no ROM
+// is known.
+bool find_rom(const char *db_path, const uint8_t *rom, size_t size,
+              rom_info_t *info) {
+    size_t table_size = 0;
+    uint8_t *table = map_table(db_path, &table_size);
+    if (!table)
+        return false;
+
+    uint8_t digest[SHA1_SIZE];
+    sha1(rom, size, digest);
+    bool found = lookup_rom(table, table_size, digest, info);
+
+    unmap_table(table, table_size);
+    return found;
+}
+
+void apply_rom_info(chip8_t *chip8, const rom_info_t *info) {
+    set_profile(chip8, info->profile);
+    if (info->display_wait >= 0)
+        chip8->quirks.display_wait = info->display_wait;
+    if (info->ipf > 0)
+        chip8->ipf = info->ipf;
+
+    for (int i = 0; i < 16; i++) {
+        if (info->keymap[i])
+            chip8->sdl.keymap[i] = info->keymap[i];
+    }
+}
@@ -0,0 +1,34 @@
+/*
+ROM database. Settings for known ROMs are kept as fixed size records sorted
+by the SHA-1 of the ROM image. The table is mapped into memory and binary
+searched, so a lookup costs a hash and a handful of compares.
+*/
+
+#ifndef ROMDB_H
+#define ROMDB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+#include "romdb_format.h"
+
+#define ROMDB_PATH "chip-8/data/roms.db"
+
+// Settings of a ROM found in the database
+typedef struct {
+    profile_t profile;
+    int display_wait;        // -1 = profile default
+    int ipf;                 // 0 = default
+    SDL_Keycode keymap[16];  // 0 = default
+} rom_info_t;
+
+void sha1(const uint8_t *data, size_t size, uint8_t digest[SHA1_SIZE]);
+bool lookup_rom(const uint8_t *table, size_t size,
+                const uint8_t digest[SHA1_SIZE], rom_info_t *info);
+bool find_rom(const char *db_path, const uint8_t *rom, size_t size,
+              rom_info_t *info);
+void apply_rom_info(chip8_t *chip8, const rom_info_t *info);
+
+#endif /* ROMDB_H */
@@ -0,0 +1,33 @@
+/*
+On-disk layout of the ROM database, shared by the emulator and the tool that
+builds the table. Kept free of SDL so the tool builds without it.
+*/
+
+#ifndef ROMDB_FORMAT_H
+#define ROMDB_FORMAT_H
+
+#include <stdint.h>
+
+#define ROMDB_MAGIC "C8DB"
+#define ROMDB_VERSION 1
+
+#define SHA1_SIZE 20
+
+// File header, followed by the records in ascending SHA-1 order
+typedef struct {
+    char magic[4];        // ROMDB_MAGIC
+    uint8_t version;      // ROMDB_VERSION
+    uint8_t record_size;  // sizeof(rom_record_t)
+    uint8_t reserved[2];
+} romdb_header_t;
+
+// One ROM. Only bytes, so the layout is the same on every platform.
+typedef struct {
+    uint8_t sha1[SHA1_SIZE];
+    uint8_t profile;      // profile_t
+    int8_t display_wait;  // Display wait quirk, -1 = profile default
+    uint8_t ipf[2];       // Instructions per frame, little endian, 0 = default
+    uint8_t keymap[16];   // Key for each CHIP-8 key, 0 = default
+} rom_record_t;
+
+#endif /* ROMDB_FORMAT_H */
@@ -0,0 +1,251 @@
+#include "saveslots.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "savestate.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Header, then two copies of every slot
+#define SLOTS_FILE_SIZE                                                      \
+    (sizeof(saveslots_header_t) + SAVESLOTS_COUNT * 2 * SAVESTATE_SIZE)
+
+struct save_slots {
+    char *path;
+    uint8_t *data;  // The whole file, or NULL until it is first needed
+};
+
+// Map the file into `slots->data`. A missing file is created empty when
+// `create` is set, and otherwise left missing with `data` still NULL, which
+// is not an error.
+#ifdef _WIN32
+static bool map_slots(save_slots_t *slots, bool create, bool *created) {
+    HANDLE file = CreateFileA(slots->path, GENERIC_READ | GENERIC_WRITE,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                              create ? OPEN_ALWAYS : OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return !create && GetLastError() == ERROR_FILE_NOT_FOUND;
+
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(file, &size)) {
+        *created = size.QuadPart == 0;
+        if (*created && !create) {
+            CloseHandle(file);  // Left empty by an interrupted create
+            return true;
+        }
+
+        // Mapping an empty file at the full size grows it, filled with zeros
+        if (*created || size.QuadPart == (LONGLONG)SLOTS_FILE_SIZE) {
+            HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, 0,
+                                                SLOTS_FILE_SIZE, NULL);
+            if (mapping) {
+                slots->data = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0,
+                                            0, SLOTS_FILE_SIZE);
+                CloseHandle(mapping);  // The view keeps it open
+            }
+        }
+    }
+    CloseHandle(file);
+    return slots->data != NULL;
+}
+
+// Start writing the changed pages back without waiting for the disk
+static void sync_slots(save_slots_t *slots) {
+    FlushViewOfFile(slots->data, SLOTS_FILE_SIZE);
+}
+
+static void unmap_slots(save_slots_t *slots) {
+    UnmapViewOfFile(slots->data);
+}
+#else
+static bool map_slots(save_slots_t *slots, bool create, bool *created) {
+    int fd = open(slots->path, O_RDWR | (create ? O_CREAT : 0), 0644);
+    if (fd == -1)
+        return !create && errno == ENOENT;
+
+    struct stat st;
+    void *data = MAP_FAILED;
+    if (fstat(fd, &st) == 0) {
+        *created = st.st_size == 0;
+        if (*created && !create) {
+            close(fd);  // Left empty by an interrupted create
+            return true;
+        }
+
+        bool sized = *created ? ftruncate(fd, SLOTS_FILE_SIZE) == 0
+                              : st.st_size == SLOTS_FILE_SIZE;
+        if (sized) {
+            data = mmap(NULL, SLOTS_FILE_SIZE, PROT_READ | PROT_WRITE,
+                        MAP_SHARED, fd, 0);
+        }
+    }
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+    slots->data = data;
+    return true;
+}
+
+// Start writing the file back without waiting for it
+static void sync_slots(save_slots_t *slots) {
+    msync(slots->data, SLOTS_FILE_SIZE, MS_ASYNC);
+}
+
+static void unmap_slots(save_slots_t *slots) {
+    munmap(slots->data, SLOTS_FILE_SIZE);
+}
+#endif
+
+static uint8_t *slot_copy(save_slots_t *slots, int slot, int copy) {
+    return slots->data + sizeof(saveslots_header_t) +
+           (size_t)(slot * 2 + copy) * SAVESTATE_SIZE;
+}
+
+// FNV-1a over a copy. A copy never written has a checksum of 0, which
+// no state hashes to in practice.
+static uint32_t checksum_copy(const uint8_t *copy) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < SAVESTATE_SIZE; i++) {
+        hash = (hash ^ copy[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool is_intact(save_slots_t *slots, int slot, int copy) {
+    const saveslots_header_t *header = (saveslots_header_t *)slots->data;
+    return checksum_copy(slot_copy(slots, slot, copy)) ==
+           header->checksum[slot][copy];
+}
+
+static bool is_compatible(const save_slots_t *slots) {
+    const saveslots_header_t *header = (saveslots_header_t *)slots->data;
+    bool magic =
+        memcmp(header->magic, SAVESLOTS_MAGIC, sizeof(header->magic)) == 0;
+    return magic && header->version == SAVESLOTS_VERSION &&
+           header->slots == SAVESLOTS_COUNT &&
+           header->state_size == SAVESTATE_SIZE;
+}
+
+// Open the slots file at `path`. A missing file is only created by the
+// first save, so runs that never save leave nothing behind.
+save_slots_t *slots_open(const char *path) {
+    save_slots_t *slots = calloc(1, sizeof(*slots));
+    if (slots)
+        slots->path = malloc(strlen(path) + 1);
+    if (!slots || !slots->path) {
+        fprintf(stderr, "Error: Could not allocate save slots\n");
+        free(slots);
+        return NULL;
+    }
+    strcpy(slots->path, path);
+
+    bool created = false;
+    if (!map_slots(slots, false, &created)) {
+        fprintf(stderr, "Error: Could not open save slots %s\n", path);
+        slots_close(slots);
+        return NULL;
+    }
+    if (slots->data && !is_compatible(slots)) {
+        fprintf(stderr, "Error: Incompatible save slots %s\n", path);
+        slots_close(slots);
+        return NULL;
+    }
+
+    return slots;
+}
+
+// Create and map the file on the first save, with every slot empty
+static bool create_slots(save_slots_t *slots) {
+    bool created = false;
+    if (!map_slots(slots, true, &created)) {
+        fprintf(stderr, "Error: Could not create save slots %s\n",
+                slots->path);
+        return false;
+    }
+
+    saveslots_header_t *header = (saveslots_header_t *)slots->data;
+    if (created) {
+        memcpy(header->magic, SAVESLOTS_MAGIC, sizeof(header->magic));
+        header->version = SAVESLOTS_VERSION;
+        header->slots = SAVESLOTS_COUNT;
+        header->state_size = SAVESTATE_SIZE;
+        memset(header->live, SAVESLOT_EMPTY, sizeof(header->live));
+        sync_slots(slots);
+    } else if (!is_compatible(slots)) {
+        // Another instance created it since, for a different build
+        fprintf(stderr, "Error: Incompatible save slots %s\n", slots->path);
+        unmap_slots(slots);
+        slots->data = NULL;
+        return false;
+    }
+    return true;
+}
+
+// Save into a slot. The slot's other copy is written first, and only then
+// made the live one.
+bool slots_save(save_slots_t *slots, int slot, const chip8_t *chip8) {
+    if (slot < 0 || slot >= SAVESLOTS_COUNT)
+        return false;
+    if (!slots->data && !create_slots(slots))
+        return false;
+
+    saveslots_header_t *header = (saveslots_header_t *)slots->data;
+    int shadow = header->live[slot] == 0 ? 1 : 0;
+    uint8_t *copy = slot_copy(slots, slot, shadow);
+    chip8_save_state(chip8, copy, SAVESTATE_SIZE);
+    header->checksum[slot][shadow] = checksum_copy(copy);
+
+    SDL_MemoryBarrierRelease();
+    header->live[slot] = shadow;
+    sync_slots(slots);
+    return true;
+}
+
+// Load a slot. Returns false if it was never saved, or if neither copy is
+// whole. The keypad is live input, so it is left as it is.
+bool slots_load(save_slots_t *slots, int slot, chip8_t *chip8) {
+    if (slot < 0 || slot >= SAVESLOTS_COUNT || !slots->data)
+        return false;
+
+    const saveslots_header_t *header = (saveslots_header_t *)slots->data;
+    int live = header->live[slot];
+    if (live != 0 && live != 1)
+        return false;
+
+    // A copy torn by a crash falls back to the save before it
+    int copy = live;
+    if (!is_intact(slots, slot, copy)) {
+        copy = !live;
+        if (!is_intact(slots, slot, copy)) {
+            fprintf(stderr, "Error: Save slot %d is damaged\n", slot + 1);
+            return false;
+        }
+    }
+
+    bool keypad[sizeof(chip8->keypad)];
+    memcpy(keypad, chip8->keypad, sizeof(keypad));
+    bool loaded =
+        chip8_load_state(chip8, slot_copy(slots, slot, copy), SAVESTATE_SIZE);
+    memcpy(chip8->keypad, keypad, sizeof(keypad));
+    return loaded;
+}
+
+void slots_close(save_slots_t *slots) {
+    if (slots->data)
+        unmap_slots(slots);
+    free(slots->path);
+    free(slots);
+}
@@ -0,0 +1,42 @@
+/*
+Quick-save slots. All slots of a ROM live in one file that stays mapped
+into memory once the first save creates it, so saving is a memcpy into the
+mapping and loading one back out; the kernel writes the pages back in its
+own time. Each slot has two copies. A save fills the copy not in use, then
+flips the slot's index in the header, so a slot always holds a whole state.
+
+Writes are never waited for, so after a crash the flipped index may reach
+the disk before the copy it points to. Each copy's checksum is kept next to
+the index, and a copy that fails it is passed over for the slot's other
+copy, the save before.
+*/
+
+#ifndef SAVESLOTS_H
+#define SAVESLOTS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+#define SAVESLOTS_MAGIC "C8SL"
+#define SAVESLOTS_VERSION 2
+#define SAVESLOTS_COUNT 10  // Slots in a file, one per F key
+#define SAVESLOT_EMPTY 0xFF
+
+typedef struct {
+    char magic[4];          // SAVESLOTS_MAGIC
+    uint16_t version;       // SAVESLOTS_VERSION
+    uint16_t slots;         // SAVESLOTS_COUNT
+    uint32_t state_size;    // SAVESTATE_SIZE, which catches layout changes
+    uint8_t live[SAVESLOTS_COUNT];  // Copy holding each slot, or empty
+    uint8_t reserved[2];
+    uint32_t checksum[SAVESLOTS_COUNT][2];  // Of each copy when written
+} saveslots_header_t;
+
+save_slots_t *slots_open(const char *path);
+bool slots_save(save_slots_t *slots, int slot, const chip8_t *chip8);
+bool slots_load(save_slots_t *slots, int slot, chip8_t *chip8);
+void slots_close(save_slots_t *slots);
+
+#endif /* SAVESLOTS_H */
@@ -0,0 +1,159 @@
+#include "savestate.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Write a save state into `buffer`. Returns its size, or 0 if the buffer
+// is smaller than SAVESTATE_SIZE.
+size_t chip8_save_state(const chip8_t *chip8, uint8_t *buffer, size_t size) {
+    if (size < SAVESTATE_SIZE)
+        return 0;
+
+    savestate_header_t header = {.version = SAVESTATE_VERSION,
+                                 .size = SAVESTATE_PAYLOAD};
+    memcpy(header.magic, SAVESTATE_MAGIC, sizeof(header.magic));
+
+    memcpy(buffer, &header, sizeof(header));
+    memcpy(buffer + sizeof(header), chip8, SAVESTATE_PAYLOAD);
+    return SAVESTATE_SIZE;
+}
+
+// Copy one field of chip8_t out of a save state payload. Bools are read
+// as bytes, so values other than 0 and 1 can be caught.
+#define READ_FIELD(payload, field, value)                          \
+    memcpy(&(value), (payload) + offsetof(chip8_t, field), sizeof(value))
+
+static bool is_bool(uint8_t value) {
+    return value <= 1;
+}
+
+// Check that the fields the emulator indexes with or switches on are in
+// range, so a damaged or hostile state is refused before anything is
+// copied into the running instance.
+static bool is_valid_state(const uint8_t *payload) {
+    uint16_t sp, display_width, display_height;
+    uint8_t hires, planes, draw, display_wait;
+    uint8_t keypad[sizeof(((chip8_t *)0)->keypad)];
+    uint32_t rng;
+    state_t state;
+    profile_t profile;
+    int ipf;
+
+    READ_FIELD(payload, sp, sp);
+    READ_FIELD(payload, keypad, keypad);
+    READ_FIELD(payload, hires, hires);
+    READ_FIELD(payload, display_width, display_width);
+    READ_FIELD(payload, display_height, display_height);
+    READ_FIELD(payload, planes, planes);
+    READ_FIELD(payload, rng, rng);
+    READ_FIELD(payload, state, state);
+    READ_FIELD(payload, profile, profile);
+    READ_FIELD(payload, quirks.display_wait, display_wait);
+    READ_FIELD(payload, ipf, ipf);
+    READ_FIELD(payload, draw, draw);
+
+    for (size_t i = 0; i < sizeof(keypad); i++) {
+        if (!is_bool(keypad[i]))
+            return false;
+    }
+
+    // The resolution must be the one the mode selects
+    bool resolution = hires ? display_width == HIRES_WIDTH &&
+                                  display_height == HIRES_HEIGHT
+                            : display_width == LORES_WIDTH &&
+                                  display_height == LORES_HEIGHT;
+
+    return sp <= 16 && is_bool(hires) && resolution &&
+           planes < 1 << DISPLAY_PLANES && rng != 0 &&
+           (state == RUNNING || state == PAUSED || state == QUIT) &&
+           profile >= 0 && profile < PROFILE_COUNT &&
+           is_bool(display_wait) && ipf >= 1 && ipf <= MAX_IPF &&
+           is_bool(draw);
+}
+
+// Restore a save state. The SDL object is left alone; the display is
+// redrawn on the next frame.
+bool chip8_load_state(chip8_t *chip8, const uint8_t *buffer, size_t size) {
+    savestate_header_t header;
+    if (size < sizeof(header)) {
+        fprintf(stderr, "Error: Save state too short\n");
+        return false;
+    }
+
+    memcpy(&header, buffer, sizeof(header));
+    if (memcmp(header.magic, SAVESTATE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != SAVESTATE_VERSION ||
+        header.size != SAVESTATE_PAYLOAD || size < SAVESTATE_SIZE) {
+        fprintf(stderr, "Error: Incompatible save state\n");
+        return false;
+    }
+
+    if (!is_valid_state(buffer + sizeof(header))) {
+        fprintf(stderr, "Error: Corrupt save state\n");
+        return false;
+    }
+
+    memcpy(chip8, buffer + sizeof(header), SAVESTATE_PAYLOAD);
+    mark_all_dirty(chip8);
+    chip8->draw = true;
+    return true;
+}
+
+static bool is_page_zero(const chip8_t *chip8, int page) {
+    const uint8_t *data = &chip8->memory[page * MEMORY_PAGE_SIZE];
+    for (int i = 0; i < MEMORY_PAGE_SIZE; i++) {
+        if (data[i])
+            return false;
+    }
+    return true;
+}
+
+// Clear the clone bits of pages that hold only zeros, often all but a few,
+// so clones of `root` skip them without looking. Call it on the thread that
+// owns `root`, before cloning from it and again after running it.
+void chip8_clone_prepare(chip8_t *root) {
+    for (int word = 0; word < MEMORY_PAGES / 64; word++) {
+        uint64_t *used = &root->dirty[DIRTY_CLONE][word];
+        for (int bit = 0; bit < 64 && *used >> bit; bit++) {
+            uint64_t mask = (uint64_t)1 << bit;
+            if ((*used & mask) && is_page_zero(root, word * 64 + bit))
+                *used &= ~mask;
+        }
+    }
+}
+
+// Copy the emulation state of one instance into another, for searching
+// ahead from a common point. Only pages marked in `src`'s clone bits are
+// copied, and pages `dst` had in use that `src` hasn't are cleared. `src`
+// is only read, so several threads can clone the same root at once.
+void chip8_clone(chip8_t *dst, const chip8_t *src) {
+    const uint8_t *from = (const uint8_t *)src;
+    uint8_t *to = (uint8_t *)dst;
+    memcpy(to, from, MEMORY_OFFSET);
+    size_t end = MEMORY_OFFSET + MEMORY_SIZE;
+    memcpy(&to[end], &from[end], SAVESTATE_PAYLOAD - end);
+
+    // Pages neither instance has in use are skipped 64 at a time
+    for (int word = 0; word < MEMORY_PAGES / 64; word++) {
+        uint64_t used = src->dirty[DIRTY_CLONE][word];
+        uint64_t stale = dst->dirty[DIRTY_CLONE][word];
+        for (int bit = 0; bit < 64 && (used | stale) >> bit; bit++) {
+            int page = word * 64 + bit;
+            uint64_t mask = (uint64_t)1 << bit;
+            uint8_t *data = &dst->memory[page * MEMORY_PAGE_SIZE];
+            if (used & mask) {
+                memcpy(data, &src->memory[page * MEMORY_PAGE_SIZE],
+                       MEMORY_PAGE_SIZE);
+            } else if (stale & mask) {
+                memset(data, 0, MEMORY_PAGE_SIZE);
+            }
+        }
+    }
+
+    mark_all_dirty(dst);
+    memcpy(dst->dirty[DIRTY_CLONE], src->dirty[DIRTY_CLONE],
+           sizeof(dst->dirty[DIRTY_CLONE]));
+}
@@ -0,0 +1,42 @@
+/*
+Save states. The emulation state of chip8_t (everything before its SDL
+object) is stored behind a small header as one block, so saving and
+loading are a couple of memcpys with no allocation. Clones copy the same
+state directly between instances, leaving out memory pages that
+chip8_clone_prepare found to be all zeros.
+*/
+
+#ifndef SAVESTATE_H
+#define SAVESTATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+#define SAVESTATE_MAGIC "C8ST"
+#define SAVESTATE_VERSION 1  // Bump whenever the chip8_t layout changes
+
+// Bytes of chip8_t that make up the emulation state
+#define SAVESTATE_PAYLOAD offsetof(chip8_t, sdl)
+#define SAVESTATE_SIZE (sizeof(savestate_header_t) + SAVESTATE_PAYLOAD)
+#define MEMORY_OFFSET offsetof(chip8_t, memory)  // Memory's place in it
+
+typedef struct {
+    char magic[4];     // SAVESTATE_MAGIC
+    uint16_t version;  // SAVESTATE_VERSION
+    uint16_t reserved;
+    uint32_t size;     // Payload bytes, which also catches layout changes
+} savestate_header_t;
+
+size_t chip8_save_state(const chip8_t *chip8, uint8_t *buffer, size_t size);
+bool chip8_load_state(chip8_t *chip8, const uint8_t *buffer, size_t size);
+void chip8_clone_prepare(chip8_t *root);
+
+// `dst`'s clone bits must cover every page it holds that isn't zeros, so it
+// has to be zeroed, initialized or an earlier clone; an uninitialized
+// chip8_t makes a corrupt clone.
+void chip8_clone(chip8_t *dst, const chip8_t *src);
+
+#endif /* SAVESTATE_H */
@@ -0,0 +1,86 @@
+#include "statehash.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define HASH_MULTIPLIER 0x9E3779B97F4A7C15ULL
+
+static uint64_t mix(uint64_t hash, uint64_t value) {
+    hash ^= value * HASH_MULTIPLIER;
+    hash = (hash << 31) | (hash >> 33);
+    return hash * 0xBF58476D1CE4E5B9ULL;
+}
+
+// Spread every input bit over the result
+static uint64_t finish(uint64_t hash) {
+    hash ^= hash >> 30;
+    hash *= 0xBF58476D1CE4E5B9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94D049BB133111EBULL;
+    return hash ^ (hash >> 31);
+}
+
+static uint64_t mix_bytes(uint64_t hash, const void *data, size_t size) {
+    const uint8_t *bytes = data;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, &bytes[i], sizeof(word));
+        hash = mix(hash, word);
+    }
+    for (; i < size; i++) {
+        hash = mix(hash, bytes[i]);
+    }
+    return hash;
+}
+
+// Pages are seeded with their number, so moving data between pages changes
+// the sum
+static uint64_t hash_page(const chip8_t *chip8, int page) {
+    const uint8_t *data = &chip8->memory[page * MEMORY_PAGE_SIZE];
+    return finish(mix_bytes(page, data, MEMORY_PAGE_SIZE));
+}
+
+// Hash all of memory, for a new hash or after a state was loaded
+void init_state_hash(state_hash_t *hash, chip8_t *chip8) {
+    hash->memory = 0;
+    for (int page = 0; page < MEMORY_PAGES; page++) {
+        hash->pages[page] = hash_page(chip8, page);
+        hash->memory += hash->pages[page];
+    }
+    clear_dirty_pages(chip8, DIRTY_HASH);
+}
+
+// Hash the state at the end of a frame. Fields are hashed one by one rather
+// than as raw bytes, so struct padding and frontend settings are left out.
+uint64_t hash_state(state_hash_t *hash, chip8_t *chip8) {
+    for (int page = 0; page < MEMORY_PAGES; page++) {
+        if (!is_page_dirty(chip8, DIRTY_HASH, page))
+            continue;
+
+        uint64_t updated = hash_page(chip8, page);
+        hash->memory += updated - hash->pages[page];
+        hash->pages[page] = updated;
+    }
+    clear_dirty_pages(chip8, DIRTY_HASH);
+
+    uint64_t h = hash->memory;
+    h = mix(h, chip8->pc);
+    h = mix(h, chip8->idx);
+    h = mix(h, chip8->sp);
+    h = mix_bytes(h, chip8->V, sizeof(chip8->V));
+    h = mix_bytes(h, chip8->stack, sizeof(chip8->stack));
+    h = mix_bytes(h, chip8->display, sizeof(chip8->display));
+    h = mix_bytes(h, chip8->keypad, sizeof(chip8->keypad));
+    h = mix_bytes(h, chip8->rpl, sizeof(chip8->rpl));
+    h = mix(h, chip8->hires);
+    h = mix(h, chip8->display_width);
+    h = mix(h, chip8->display_height);
+    h = mix(h, chip8->planes);
+    h = mix(h, chip8->delay_timer);
+    h = mix(h, chip8->sound_timer);
+    h = mix_bytes(h, chip8->pattern, sizeof(chip8->pattern));
+    h = mix(h, chip8->pitch);
+    h = mix(h, chip8->rng);
+    return finish(h);
+}
@@ -0,0 +1,23 @@
+/*
+State hashing. A 64-bit hash of the emulation state is kept per frame for
+comparing runs across builds and backends. Memory is hashed a page at a
+time and only pages written since the last frame are rehashed; the
+registers, display and everything else are small enough to hash in full.
+*/
+
+#ifndef STATEHASH_H
+#define STATEHASH_H
+
+#include <stdint.h>
+
+#include "chip8.h"
+
+typedef struct {
+    uint64_t pages[MEMORY_PAGES];  // Hash of each memory page
+    uint64_t memory;               // Sum of the page hashes
+} state_hash_t;
+
+void init_state_hash(state_hash_t *hash, chip8_t *chip8);
+uint64_t hash_state(state_hash_t *hash, chip8_t *chip8);
+
+#endif /* STATEHASH_H */
@@ -0,0 +1,30 @@
+#include <SDL.h>
+#include <stdbool.h>
+
+#include "chip8.h"
+
+#define SLOT_INDEX_MASK 0x3
+#define SLOT_FRESH 0x4  // Set on the middle slot until the consumer takes it
+
+void init_triple_buffer(triple_buffer_t *tb) {
+    tb->back = 0;
+    SDL_AtomicSet(&tb->middle, 1);
+    tb->front = 2;
+}
+
+// Publish the back slot and take the previous middle slot as the new back.
+void swap_back(triple_buffer_t *tb) {
+    int previous = SDL_AtomicSet(&tb->middle, tb->back | SLOT_FRESH);
+    tb->back = previous & SLOT_INDEX_MASK;
+}
+
+// Take the newest published slot as the front, if there is one. Slots
+// published while the consumer was busy are skipped, never queued.
+bool swap_front(triple_buffer_t *tb) {
+    if (!(SDL_AtomicGet(&tb->middle) & SLOT_FRESH))
+        return false;
+
+    int previous = SDL_AtomicSet(&tb->middle, tb->front);
+    tb->front = previous & SLOT_INDEX_MASK;
+    return true;
+}
@@ -0,0 +1,92 @@
+#include "wav.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+struct wav {
+    FILE *fp;
+    int sample_rate;
+    uint32_t samples;  // Written so far
+};
+
+static void put16(uint8_t *out, uint16_t value) {
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+}
+
+static void put32(uint8_t *out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = value >> (i * 8);
+    }
+}
+
+// RIFF header for the samples written so far. The sizes are only known at
+// the end, so it is written again on close.
+static bool write_header(wav_t *wav) {
+    uint32_t data_size = wav->samples * sizeof(int16_t);
+    uint8_t header[WAV_HEADER_SIZE] = "RIFF....WAVEfmt ";
+    put32(&header[4], WAV_HEADER_SIZE - 8 + data_size);
+    put32(&header[16], 16);  // Format chunk size
+    put16(&header[20], 1);   // PCM
+    put16(&header[22], 1);   // Mono
+    put32(&header[24], wav->sample_rate);
+    put32(&header[28], wav->sample_rate * sizeof(int16_t));
+    put16(&header[32], sizeof(int16_t));
+    put16(&header[34], 16);  // Bits per sample
+    header[36] = 'd';
+    header[37] = 'a';
+    header[38] = 't';
+    header[39] = 'a';
+    put32(&header[40], data_size);
+
+    return fseek(wav->fp, 0, SEEK_SET) == 0 &&
+           fwrite(header, sizeof(header), 1, wav->fp) == 1;
+}
+
+wav_t *wav_open(const char *path, int sample_rate) {
+    wav_t *wav = calloc(1, sizeof(*wav));
+    if (!wav) {
+        fprintf(stderr, "Error: Could not allocate WAV output\n");
+        return NULL;
+    }
+
+    wav->sample_rate = sample_rate;
+    wav->fp = fopen(path, "wb");
+    if (!wav->fp || !write_header(wav)) {
+        fprintf(stderr, "Error: Could not create %s\n", path);
+        if (wav->fp)
+            fclose(wav->fp);
+        free(wav);
+        return NULL;
+    }
+    return wav;
+}
+
+// Append samples. They are stored little endian whatever the host.
+bool wav_write(wav_t *wav, const int16_t *samples, int count) {
+    uint8_t bytes[1024];
+    int done = 0;
+    while (done < count) {
+        int n = count - done;
+        if (n > (int)sizeof(bytes) / 2)
+            n = sizeof(bytes) / 2;
+        for (int i = 0; i < n; i++) {
+            put16(&bytes[i * 2], (uint16_t)samples[done + i]);
+        }
+        if (fwrite(bytes, 2, n, wav->fp) != (size_t)n)
+            return false;
+        done += n;
+    }
+
+    wav->samples += count;
+    return true;
+}
+
+void wav_close(wav_t *wav) {
+    if (!write_header(wav))
+        fprintf(stderr, "Error: Could not finish WAV output\n");
+    fclose(wav->fp);
+    free(wav);
+}
@@ -0,0 +1,21 @@
+/*
+WAV output of the audio a run produces, as 16-bit mono PCM. Headless runs
+render each frame's samples in bulk and append them here, so sound can be
+checked without an audio device.
+*/
+
+#ifndef WAV_H
+#define WAV_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "chip8.h"
+
+#define WAV_HEADER_SIZE 44
+
+wav_t *wav_open(const char *path, int sample_rate);
+bool wav_write(wav_t *wav, const int16_t *samples, int count);
+void wav_close(wav_t *wav);
+
+#endif /* WAV_H */
@@ -0,0 +1,79 @@
+/*
+Measures how fast running instances can be cloned, as a tree search does
+when it expands a node:
+
+    bench_clone <rom.ch8> [clones]
+
+The ROM runs for a second of frames first, then is cloned over and over
+into a few instances in turn, each of which runs a frame after being
+cloned into. Prints clones per second, with and without the frame, and
+the memory each clone takes.
+*/
+
+#define SDL_MAIN_HANDLED
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../src/chip8.h"
+#include "../src/savestate.h"
+
+#define CLONES 100000
+#define INSTANCES 8  // Clones kept, as a search keeps several children
+
+static chip8_t root;
+static chip8_t instances[INSTANCES];
+
+static double seconds_since(uint64_t start) {
+    uint64_t now = SDL_GetPerformanceCounter();
+    return (now - start) / (double)SDL_GetPerformanceFrequency();
+}
+
+static double bench(long clones, bool step) {
+    uint64_t start = SDL_GetPerformanceCounter();
+    for (long i = 0; i < clones; i++) {
+        chip8_t *clone = &instances[i % INSTANCES];
+        chip8_clone(clone, &root);
+        if (step)
+            emulate_frame(clone);
+    }
+    return clones / seconds_since(start);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2 && argc != 3) {
+        fprintf(stderr, "Usage: bench_clone <rom.ch8> [clones]\n");
+        return EXIT_FAILURE;
+    }
+    long clones = argc == 3 ? atol(argv[2]) : CLONES;
+    if (clones < 1) {
+        fprintf(stderr, "Error: Invalid clone count %s\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    initialize(&root);
+    if (read_rom(&root.memory[PC_START], argv[1]) == 0)
+        return EXIT_FAILURE;
+    for (int i = 0; i < INSTANCES; i++) {
+        initialize(&instances[i]);
+    }
+    for (int frame = 0; frame < 60; frame++) {
+        emulate_frame(&root);
+        tick_timers(&root);
+    }
+
+    chip8_clone_prepare(&root);
+    int pages = 0;
+    for (int page = 0; page < MEMORY_PAGES; page++) {
+        pages += is_page_dirty(&root, DIRTY_CLONE, page);
+    }
+
+    printf("Clone only:       %.0f clones/s\n", bench(clones, false));
+    printf("Clone and frame:  %.0f clones/s\n", bench(clones, true));
+    printf("Memory per clone: %zu bytes, %zu of emulation state\n",
+           sizeof(chip8_t), SAVESTATE_PAYLOAD);
+    printf("Copied per clone: %zu bytes (%d of %d memory pages)\n",
+           SAVESTATE_PAYLOAD - MEMORY_SIZE + pages * MEMORY_PAGE_SIZE, pages,
+           MEMORY_PAGES);
+    return EXIT_SUCCESS;
+}
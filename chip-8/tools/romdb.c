@@ -0,0 +1,147 @@
+/*
+Builds the binary ROM database from its text source:
+
+    romdb <roms.txt> <roms.db>
+
+Each line of the source holds a ROM's SHA-1 as printed by sha1sum, its
+profile, the display wait quirk (on, off or - for the profile default),
+instructions per frame (- for the default) and a keymap of 16 keys for the
+CHIP-8 keys 0-F (. keeps a key's default, - keeps them all; letters are
+case-insensitive). Text after a # is ignored.
+*/
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/profile.h"
+#include "../src/romdb_format.h"
+
+#define MAX_RECORDS 4096
+#define MAX_LINE 256
+
+static rom_record_t records[MAX_RECORDS];
+
+static int compare_records(const void *a, const void *b) {
+    const rom_record_t *left = a;
+    const rom_record_t *right = b;
+    return memcmp(left->sha1, right->sha1, SHA1_SIZE);
+}
+
+static bool parse_sha1(const char *hex, uint8_t digest[SHA1_SIZE]) {
+    if (strlen(hex) != SHA1_SIZE * 2)
+        return false;
+
+    for (int i = 0; i < SHA1_SIZE; i++) {
+        unsigned int byte;
+        if (sscanf(&hex[i * 2], "%2x", &byte) != 1)
+            return false;
+        digest[i] = byte;
+    }
+    return true;
+}
+
+static bool parse_record(const char *line, rom_record_t *record) {
+    char hex[64], profile[32], wait[8], ipf[8], keymap[32];
+    if (sscanf(line, "%63s %31s %7s %7s %31s", hex, profile, wait, ipf,
+               keymap) != 5)
+        return false;
+
+    memset(record, 0, sizeof(*record));
+    if (!parse_sha1(hex, record->sha1))
+        return false;
+
+    profile_t parsed;
+    if (!parse_profile(profile, &parsed))
+        return false;
+    record->profile = parsed;
+
+    if (strcmp(wait, "-") == 0) {
+        record->display_wait = -1;
+    } else if (strcmp(wait, "on") == 0 || strcmp(wait, "off") == 0) {
+        record->display_wait = strcmp(wait, "on") == 0;
+    } else {
+        return false;
+    }
+
+    if (strcmp(ipf, "-") != 0) {
+        int value = atoi(ipf);
+        if (value < 1 || value > 0xFFFF)
+            return false;
+        record->ipf[0] = value & 0xFF;
+        record->ipf[1] = value >> 8;
+    }
+
+    // Digits, lowercase letters and punctuation have their ASCII value as
+    // SDL key code, so letters are lowercased
+    if (strcmp(keymap, "-") != 0) {
+        if (strlen(keymap) != 16)
+            return false;
+        for (int i = 0; i < 16; i++) {
+            if (keymap[i] != '.')
+                record->keymap[i] = tolower((unsigned char)keymap[i]);
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: romdb <roms.txt> <roms.db>\n");
+        return EXIT_FAILURE;
+    }
+
+    FILE *source = fopen(argv[1], "r");
+    if (!source) {
+        fprintf(stderr, "Error: Could not open %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    char line[MAX_LINE];
+    int count = 0;
+    for (int number = 1; fgets(line, sizeof(line), source); number++) {
+        line[strcspn(line, "#\n")] = '\0';
+        if (line[strspn(line, " \t\r")] == '\0')
+            continue;
+
+        if (count == MAX_RECORDS || !parse_record(line, &records[count])) {
+            fprintf(stderr, "Error: %s:%d: Invalid entry\n", argv[1], number);
+            fclose(source);
+            return EXIT_FAILURE;
+        }
+        count++;
+    }
+    fclose(source);
+
+    // Sorted by hash so lookups can binary search the table
+    qsort(records, count, sizeof(rom_record_t), compare_records);
+    for (int i = 1; i < count; i++) {
+        if (compare_records(&records[i - 1], &records[i]) == 0) {
+            fprintf(stderr, "Error: Duplicate ROM in %s\n", argv[1]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    romdb_header_t header = {.version = ROMDB_VERSION,
+                             .record_size = sizeof(rom_record_t)};
+    memcpy(header.magic, ROMDB_MAGIC, sizeof(header.magic));
+
+    FILE *db = fopen(argv[2], "wb");
+    if (!db) {
+        fprintf(stderr, "Error: Could not create %s\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+    bool written = fwrite(&header, sizeof(header), 1, db) == 1 &&
+                   fwrite(records, sizeof(rom_record_t), count, db) ==
+                       (size_t)count;
+    if (fclose(db) != 0 || !written) {
+        fprintf(stderr, "Error: Could not write %s\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    printf("%d ROMs written to %s\n", count, argv[2]);
+    return EXIT_SUCCESS;
+}
@@ -1,6 +1,16 @@
 #include <stdio.h>
+#include <string.h>
 
+#include "../chip-8/src/capture.h"
 #include "../chip-8/src/chip8.h"
+#include "../chip-8/src/movie.h"
+#include "../chip-8/src/netplay.h"
+#include "../chip-8/src/rewind.h"
+#include "../chip-8/src/romdb.h"
+#include "../chip-8/src/saveslots.h"
+#include "../chip-8/src/savestate.h"
+#include "../chip-8/src/statehash.h"
+#include "../chip-8/src/wav.h"
 #include "unity/unity.h"
 
 chip8_t chip8;
@@ -33,12 +43,14 @@ void test_should_zero_initialize(void) {
 
     TEST_ASSERT_EACH_EQUAL_UINT8(0, chip8.V, 16);
     TEST_ASSERT_EACH_EQUAL_UINT16(0, chip8.stack, 16);
-    TEST_ASSERT_EACH_EQUAL_UINT8(0, chip8.display, 64 * 32);
+    TEST_ASSERT_EACH_EQUAL_UINT8(0, chip8.display, sizeof(chip8.display));
+    TEST_ASSERT_EQUAL(64, chip8.display_width);
+    TEST_ASSERT_EQUAL(32, chip8.display_height);
 
-    // Test memory except the fontset memory range
+    // Test memory except the fontset memory ranges
     TEST_ASSERT_EACH_EQUAL_UINT8(0, &chip8.memory[0], FONT_START);
-    TEST_ASSERT_EACH_EQUAL_UINT8(0, &chip8.memory[FONT_END],
-                                 MEMORY_SIZE - FONT_END);
+    TEST_ASSERT_EACH_EQUAL_UINT8(0, &chip8.memory[BIG_FONT_END],
+                                 MEMORY_SIZE - BIG_FONT_END);
 
     TEST_ASSERT_NULL(chip8.sdl.window);
     TEST_ASSERT_NULL(chip8.sdl.renderer);
@@ -73,6 +85,7 @@ void test_should_setup_sdl(void) {
     setup_sdl(&chip8.sdl);
     TEST_ASSERT_NOT_NULL(chip8.sdl.window);
     TEST_ASSERT_NOT_NULL(chip8.sdl.renderer);
+    cleanup(&chip8.sdl);
 }
 
 void test_should_cleanup_sdl(void) {
@@ -82,6 +95,937 @@ void test_should_cleanup_sdl(void) {
     TEST_ASSERT_NULL(chip8.sdl.renderer);
 }
 
+void test_should_hand_input_from_events_to_emulator(void) {
+    SDL_Event event;
+    memset(&event, 0, sizeof(event));
+    event.type = SDL_KEYDOWN;
+    event.key.keysym.sym = chip8.sdl.keymap[0xA];
+    handle_event(&chip8.sdl, &event);
+
+    // The keypad only changes when the emulator takes the input
+    TEST_ASSERT_FALSE(chip8.keypad[0xA]);
+    read_input(&chip8);
+    TEST_ASSERT_TRUE(chip8.keypad[0xA]);
+
+    event.type = SDL_KEYUP;
+    handle_event(&chip8.sdl, &event);
+    event.type = SDL_QUIT;
+    handle_event(&chip8.sdl, &event);
+    read_input(&chip8);
+    TEST_ASSERT_EQUAL(QUIT, chip8.state);
+}
+
+void test_should_bound_fade_length(void) {
+    TEST_ASSERT_EQUAL(1, fade_length(0));
+    TEST_ASSERT_EQUAL(9, fade_length(128));
+    TEST_ASSERT_EQUAL(255, fade_length(254));
+    TEST_ASSERT_EQUAL(255, fade_length(255));  // Never decays
+}
+
+void test_should_hand_over_newest_frame(void) {
+    frame_buffer_t *fb = &chip8.sdl.frames;
+    triple_buffer_t *slots = &fb->slots;
+    init_frame_buffer(fb);
+
+    // Nothing published yet
+    TEST_ASSERT_FALSE(swap_front(slots));
+
+    // Two frames published before the renderer wakes; only the newest is seen
+    fb->frames[slots->back].width = 64;
+    swap_back(slots);
+    fb->frames[slots->back].width = 128;
+    swap_back(slots);
+
+    TEST_ASSERT_TRUE(swap_front(slots));
+    TEST_ASSERT_EQUAL(128, fb->frames[slots->front].width);
+    TEST_ASSERT_FALSE(swap_front(slots));
+
+    // The three slots stay distinct
+    int middle = SDL_AtomicGet(&slots->middle) & 0x3;
+    TEST_ASSERT_NOT_EQUAL(slots->back, slots->front);
+    TEST_ASSERT_NOT_EQUAL(slots->back, middle);
+    TEST_ASSERT_NOT_EQUAL(slots->front, middle);
+}
+
+// Fill program memory with `count` copies of `opcode`
+static void load_opcodes(uint16_t opcode, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        chip8.memory[PC_START + 2 * i] = opcode >> 8;
+        chip8.memory[PC_START + 2 * i + 1] = opcode & 0xFF;
+    }
+}
+
+void test_should_end_frame_on_draw_with_display_wait(void) {
+    set_profile(&chip8, PROFILE_VIP);
+    TEST_ASSERT_TRUE(chip8.quirks.display_wait);
+
+    load_opcodes(0xD001, INSTRUCTIONS_PER_FRAME);
+    emulate_frame(&chip8);
+    TEST_ASSERT_EQUAL_HEX(PC_START + 2, chip8.pc);
+}
+
+void test_should_run_full_budget_without_display_wait(void) {
+    set_profile(&chip8, PROFILE_SCHIP_MODERN);
+    TEST_ASSERT_FALSE(chip8.quirks.display_wait);
+
+    load_opcodes(0xD001, INSTRUCTIONS_PER_FRAME);
+    emulate_frame(&chip8);
+    TEST_ASSERT_EQUAL_HEX(PC_START + 2 * INSTRUCTIONS_PER_FRAME, chip8.pc);
+}
+
+void test_should_parse_profile_names(void) {
+    profile_t profile;
+    TEST_ASSERT_TRUE(parse_profile("xochip", &profile));
+    TEST_ASSERT_EQUAL(PROFILE_XOCHIP, profile);
+    TEST_ASSERT_FALSE(parse_profile("chip-48", &profile));
+}
+
+// Load `words` program words at PC_START and execute `steps` instructions
+static void run_program(const uint16_t *words, size_t count, size_t steps) {
+    for (size_t i = 0; i < count; i++) {
+        chip8.memory[PC_START + 2 * i] = words[i] >> 8;
+        chip8.memory[PC_START + 2 * i + 1] = words[i] & 0xFF;
+    }
+
+    chip8.pc = PC_START;
+    for (size_t i = 0; i < steps; i++) {
+        emulate_cycle(&chip8);
+    }
+}
+
+// Run the given two byte opcodes from PC_START
+static void run_opcodes(const uint16_t *opcodes, size_t count) {
+    run_program(opcodes, count, count);
+}
+
+void test_should_switch_to_hires(void) {
+    set_profile(&chip8, PROFILE_SCHIP_MODERN);
+    uint16_t program[] = {0x00FF};
+    run_opcodes(program, 1);
+
+    TEST_ASSERT_TRUE(chip8.hires);
+    TEST_ASSERT_EQUAL(128, chip8.display_width);
+    TEST_ASSERT_EQUAL(64, chip8.display_height);
+}
+
+void test_should_ignore_schip_opcodes_on_vip(void) {
+    uint16_t program[] = {0x00FF};
+    run_opcodes(program, 1);
+    TEST_ASSERT_FALSE(chip8.hires);
+}
+
+void test_should_draw_16x16_sprite_in_hires(void) {
+    set_profile(&chip8, PROFILE_SCHIP_MODERN);
+    memset(&chip8.memory[0x300], 0xFF, 32);
+
+    // 16x16 sprite straddling the two words of each row
+    uint16_t program[] = {0x00FF, 0xA300, 0x6038, 0x6104, 0xD010};
+    run_opcodes(program, 5);
+
+    TEST_ASSERT_FALSE(get_pixel(chip8.display[0], 55, 4));
+    TEST_ASSERT_TRUE(get_pixel(chip8.display[0], 56, 4));
+    TEST_ASSERT_TRUE(get_pixel(chip8.display[0], 71, 19));
+    TEST_ASSERT_FALSE(get_pixel(chip8.display[0], 72, 19));
+    TEST_ASSERT_FALSE(get_pixel(chip8.display[0], 56, 20));
+    TEST_ASSERT_EQUAL(0, chip8.V[0xF]);
+}
+
+void test_should_clip_sprite_at_bottom_right(void) {
+    memset(&chip8.memory[0x300], 0xFF, 15);
+    chip8.keypad[0] = false;
+
+    // Sprite at (60, 28) with 15 rows would overflow the display
+    uint16_t program[] = {0xA300, 0x603C, 0x611C, 0xD01F};
+    run_opcodes(program, 4);
+
+    TEST_ASSERT_TRUE(get_pixel(chip8.display[0], 63, 31));
+    TEST_ASSERT_FALSE(get_pixel(chip8.display[0], 0, 29));
+    TEST_ASSERT_EACH_EQUAL_UINT8(0, chip8.display[0][32],
+                                 sizeof(chip8.display[0][32]));
+    TEST_ASSERT_EACH_EQUAL_UINT8(false, chip8.keypad, sizeof(chip8.keypad));
+}
+
+void test_should_scroll_display(void) {
+    set_profile(&chip8, PROFILE_SCHIP_MODERN);
+    chip8.memory[0x300] = 0x80;
+
+    // One pixel at (60, 0), scrolled down 3 and right across the word edge
+    uint16_t program[] = {0x00FF, 0xA300, 0x603C, 0x6100,
+                          0xD011, 0x00C3, 0x00FB};
+    run_opcodes(program, 7);
+
+    TEST_ASSERT_FALSE(get_pixel(chip8.display[0], 60, 0));
+    TEST_ASSERT_TRUE(get_pixel(chip8.display[0], 64, 3));
+
+    uint16_t left[] = {0x00FC, 0x00FC};
+    run_opcodes(left, 2);
+    TEST_ASSERT_TRUE(get_pixel(chip8.display[0], 56, 3));
+    TEST_ASSERT_FALSE(get_pixel(chip8.display[0], 64, 3));
+}
+
+// Pixel at lores (8, 0) after scrolling down 2 and right 4 hires pixels
+static void scroll_lores(profile_t profile) {
+    initialize(&chip8);
+    set_profile(&chip8, profile);
+    chip8.memory[0x300] = 0x80;
+    uint16_t program[] = {0xA300, 0x6008, 0x6100, 0xD011, 0x00C2, 0x00FB};
+    run_opcodes(program, 6);
+}
+
+void test_should_scroll_lores_by_profile(void) {
+    // SUPER-CHIP 1.1 moves half the distance in lores
+    scroll_lores(PROFILE_SCHIP_LEGACY);
+    TEST_ASSERT_TRUE(get_pixel(chip8.display[0], 10, 1));
+
+    // Later interpreters move whole lores pixels
+    scroll_lores(PROFILE_SCHIP_MODERN);
+    TEST_ASSERT_TRUE(get_pixel(chip8.display[0], 12, 2));
+    scroll_lores(PROFILE_XOCHIP);
+    TEST_ASSERT_TRUE(get_pixel(chip8.display[0], 12, 2));
+}
+
+// DXY0 at (0, 0) in lores from a block of set sprite bytes
+static void draw_lores_dxy0(profile_t profile) {
+    initialize(&chip8);
+    set_profile(&chip8, profile);
+    memset(&chip8.memory[0x300], 0xFF, 32);
+    uint16_t program[] = {0xA300, 0x6000, 0x6100, 0xD010};
+    run_opcodes(program, 4);
+}
+
+void test_should_draw_lores_dxy0_by_profile(void) {
+    draw_lores_dxy0(PROFILE_SCHIP_LEGACY);
+    TEST_ASSERT_TRUE(get_pixel(chip8.display[0], 7, 15));
+    TEST_ASSERT_FALSE(get_pixel(chip8.display[0], 8, 0));
+
+    draw_lores_dxy0(PROFILE_SCHIP_MODERN);
+    TEST_ASSERT_TRUE(get_pixel(chip8.display[0], 15, 15));
+    TEST_ASSERT_FALSE(get_pixel(chip8.display[0], 0, 16));
+}
+
+void test_should_save_and_load_rpl_flags(void) {
+    set_profile(&chip8, PROFILE_SCHIP_LEGACY);
+    uint16_t program[] = {0x6011, 0x6122, 0xF175, 0x6000, 0x6100, 0xF185};
+    run_opcodes(program, 6);
+
+    TEST_ASSERT_EQUAL_HEX8(0x11, chip8.V[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x22, chip8.V[1]);
+}
+
+void test_should_point_to_big_font(void) {
+    set_profile(&chip8, PROFILE_SCHIP_LEGACY);
+    uint16_t program[] = {0x6003, 0xF030};
+    run_opcodes(program, 2);
+    TEST_ASSERT_EQUAL_HEX(BIG_FONT_START + 3 * BIG_FONT_HEIGHT, chip8.idx);
+}
+
+void test_should_load_long_index(void) {
+    set_profile(&chip8, PROFILE_XOCHIP);
+    uint16_t program[] = {0xF000, 0xE123, 0x6001};
+    run_program(program, 3, 2);
+
+    TEST_ASSERT_EQUAL_HEX(0xE123, chip8.idx);
+    TEST_ASSERT_EQUAL(1, chip8.V[0]);
+}
+
+void test_should_skip_over_long_index(void) {
+    set_profile(&chip8, PROFILE_XOCHIP);
+    uint16_t program[] = {0x3000, 0xF000, 0x1234, 0x6001};
+    run_program(program, 4, 2);
+
+    TEST_ASSERT_EQUAL_HEX(0x0000, chip8.idx);
+    TEST_ASSERT_EQUAL(1, chip8.V[0]);
+}
+
+void test_should_save_and_load_register_range(void) {
+    set_profile(&chip8, PROFILE_XOCHIP);
+    uint16_t program[] = {0x6211, 0x6322, 0x6433, 0xA400, 0x5422, 0x5243};
+    run_opcodes(program, 6);
+
+    // Stored in reverse order, then loaded back the other way round
+    TEST_ASSERT_EQUAL_HEX8(0x33, chip8.memory[0x400]);
+    TEST_ASSERT_EQUAL_HEX8(0x11, chip8.memory[0x402]);
+    TEST_ASSERT_EQUAL_HEX8(0x33, chip8.V[2]);
+    TEST_ASSERT_EQUAL_HEX8(0x11, chip8.V[4]);
+}
+
+void test_should_draw_to_selected_planes(void) {
+    set_profile(&chip8, PROFILE_XOCHIP);
+    chip8.memory[0x400] = 0x80;  // Plane 1 sprite
+    chip8.memory[0x401] = 0xC0;  // Plane 2 sprite
+
+    uint16_t program[] = {0xF301, 0xA400, 0x6000, 0x6100, 0xD011};
+    run_opcodes(program, 5);
+
+    TEST_ASSERT_EQUAL(3, get_color(chip8.display, 0, 0));
+    TEST_ASSERT_EQUAL(2, get_color(chip8.display, 1, 0));
+
+    // Clearing plane 2 only leaves plane 1
+    uint16_t clear[] = {0xF201, 0x00E0};
+    run_opcodes(clear, 2);
+    TEST_ASSERT_EQUAL(1, get_color(chip8.display, 0, 0));
+    TEST_ASSERT_EQUAL(0, get_color(chip8.display, 1, 0));
+}
+
+void test_should_scroll_up(void) {
+    set_profile(&chip8, PROFILE_XOCHIP);
+    chip8.memory[0x400] = 0x80;
+    uint16_t program[] = {0x00FF, 0xA400, 0x6000, 0x6105, 0xD011, 0x00D2};
+    run_opcodes(program, 6);
+
+    TEST_ASSERT_TRUE(get_pixel(chip8.display[0], 0, 3));
+    TEST_ASSERT_FALSE(get_pixel(chip8.display[0], 0, 5));
+}
+
+void test_should_read_sprite_across_end_of_memory(void) {
+    set_profile(&chip8, PROFILE_XOCHIP);
+    chip8.memory[0xFFFF] = 0x80;
+    chip8.memory[0x0000] = 0x80;
+    uint16_t program[] = {0xF000, 0xFFFF, 0x6000, 0x6100, 0xD012};
+    run_program(program, 5, 4);
+
+    TEST_ASSERT_TRUE(get_pixel(chip8.display[0], 0, 0));
+    TEST_ASSERT_TRUE(get_pixel(chip8.display[0], 0, 1));
+}
+
+void test_should_load_audio_pattern_and_pitch(void) {
+    set_profile(&chip8, PROFILE_XOCHIP);
+    for (int i = 0; i < AUDIO_PATTERN_SIZE; i++) {
+        chip8.memory[0x400 + i] = i;
+    }
+    uint16_t program[] = {0xA400, 0xF002, 0x6070, 0xF03A};
+    run_opcodes(program, 4);
+
+    TEST_ASSERT_EQUAL_HEX8(0x00, chip8.pattern[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x0F, chip8.pattern[15]);
+    TEST_ASSERT_EQUAL(0x70, chip8.pitch);
+}
+
+void test_should_render_audio_while_sound_timer_runs(void) {
+    audio_t *audio = &chip8.sdl.audio;
+    audio->sample_rate = 4000;  // One pattern bit per sample at pitch 64
+    chip8.pattern[0] = 0xA0;
+    chip8.sound_timer = 1;
+    int16_t samples[80];
+
+    update_timers(&chip8);
+    TEST_ASSERT_TRUE(swap_front(&audio->slots));
+    render_audio(audio, samples, 80);
+    TEST_ASSERT_EQUAL(AUDIO_VOLUME, samples[0]);
+    TEST_ASSERT_EQUAL(-AUDIO_VOLUME, samples[1]);
+    TEST_ASSERT_EQUAL(AUDIO_VOLUME, samples[2]);
+    TEST_ASSERT_EQUAL(-AUDIO_VOLUME, samples[3]);
+
+    // The timer runs out at the end of the frame, 66.7 samples in, and not
+    // at the end of the buffer. The tone itself is unchanged and not
+    // published again.
+    TEST_ASSERT_NOT_EQUAL(0, samples[66]);
+    TEST_ASSERT_EQUAL(0, samples[67]);
+    TEST_ASSERT_EQUAL(0, samples[79]);
+    update_timers(&chip8);
+    TEST_ASSERT_FALSE(swap_front(&audio->slots));
+    render_audio(audio, samples, 4);
+    TEST_ASSERT_EQUAL(0, samples[0]);
+    TEST_ASSERT_EQUAL(0, samples[3]);
+}
+
+void test_should_start_sound_on_the_instruction_that_sets_it(void) {
+    audio_t *audio = &chip8.sdl.audio;
+    audio->sample_rate = 4000;
+    chip8.ipf = 10;
+
+    // F018 is the sixth instruction, half way through the frame
+    load_opcodes(0x6002, 10);
+    chip8.memory[PC_START + 10] = 0xF0;
+    chip8.memory[PC_START + 11] = 0x18;
+    emulate_frame(&chip8);
+    TEST_ASSERT_EQUAL(1, chip8.sound_edge_count);
+    TEST_ASSERT_EQUAL(5, chip8.sound_edges[0].cycle);
+
+    int16_t samples[80];
+    update_timers(&chip8);
+    render_audio(audio, samples, 80);
+    TEST_ASSERT_EQUAL(0, samples[33]);
+    TEST_ASSERT_NOT_EQUAL(0, samples[34]);
+    TEST_ASSERT_NOT_EQUAL(0, samples[79]);
+}
+
+void test_should_steer_audio_lead_towards_target(void) {
+    audio_t *audio = &chip8.sdl.audio;
+    audio->sample_rate = 4000;
+    int16_t samples[200];
+
+    // Nothing queued: frames stretch as far as they may to fill up
+    pace_audio(audio);
+    TEST_ASSERT_TRUE(audio->ratio == 1.0 + AUDIO_MAX_SKEW);
+    advance_audio(audio);
+    TEST_ASSERT_INT_WITHIN(1, 67, audio_lead(audio));
+
+    // The device played past emulation, which carries on from there
+    render_audio(audio, samples, 200);
+    TEST_ASSERT_INT_WITHIN(1, -133, audio_lead(audio));
+    pace_audio(audio);
+    TEST_ASSERT_EQUAL(0, audio_lead(audio));
+
+    // At the target, frames are back to their nominal length
+    audio->clock += AUDIO_SYNC_LEAD;
+    pace_audio(audio);
+    TEST_ASSERT_TRUE(audio->ratio == 1.0);
+}
+
+void test_should_render_headless_audio_to_wav(void) {
+    const char *wav_path = "test_audio.wav";
+    audio_t *audio = &chip8.sdl.audio;
+    audio->sample_rate = 6000;  // 100 samples a frame
+    chip8.ipf = 10;
+    uint16_t program[] = {0x6002, 0xF018, 0x1204};
+    run_program(program, 3, 0);
+
+    wav_t *wav = wav_open(wav_path, audio->sample_rate);
+    TEST_ASSERT_NOT_NULL(wav);
+    int16_t samples[200];
+    for (int frame = 0; frame < 3; frame++) {
+        emulate_frame(&chip8);
+        update_timers(&chip8);
+        int count = render_frame_audio(audio, samples, 200);
+        TEST_ASSERT_EQUAL(100, count);
+        TEST_ASSERT_TRUE(wav_write(wav, samples, count));
+
+        // Sound starts on the second instruction and lasts two frames
+        if (frame == 0) {
+            TEST_ASSERT_EQUAL(0, samples[9]);
+            TEST_ASSERT_NOT_EQUAL(0, samples[10]);
+        } else if (frame == 1) {
+            TEST_ASSERT_NOT_EQUAL(0, samples[99]);
+        } else {
+            TEST_ASSERT_EACH_EQUAL_INT16(0, samples, count);
+        }
+    }
+    wav_close(wav);
+
+    FILE *fp = fopen(wav_path, "rb");
+    TEST_ASSERT_NOT_NULL(fp);
+    uint8_t header[WAV_HEADER_SIZE];
+    TEST_ASSERT_EQUAL(1, fread(header, sizeof(header), 1, fp));
+    TEST_ASSERT_EQUAL(WAV_HEADER_SIZE + 600, get_rom_size(fp));
+    fclose(fp);
+    remove(wav_path);
+    TEST_ASSERT_EQUAL_MEMORY("RIFF", header, 4);
+    TEST_ASSERT_EQUAL_HEX8(0x70, header[24]);  // 6000 Hz
+    TEST_ASSERT_EQUAL_HEX8(0x17, header[25]);
+    TEST_ASSERT_EQUAL_MEMORY("data", &header[36], 4);
+    TEST_ASSERT_EQUAL(600, header[40] | header[41] << 8);
+}
+
+void test_should_open_audio_once_sound_first_plays(void) {
+    audio_t *audio = &chip8.sdl.audio;
+    audio->wanted = true;
+
+    update_timers(&chip8);
+    TEST_ASSERT_TRUE(audio->wanted);
+    TEST_ASSERT_NULL(audio->opener);
+
+    chip8.sound_timer = 3;
+    update_timers(&chip8);
+    TEST_ASSERT_FALSE(audio->wanted);
+    close_audio(audio);  // Waits for the opener
+    TEST_ASSERT_NULL(audio->opener);
+    TEST_ASSERT_EQUAL(0, audio->device);
+}
+
+void test_should_shift_vy_without_shift_quirk(void) {
+    uint16_t program[] = {0x6003, 0x6181, 0x8016, 0x621F, 0x832E};
+    run_opcodes(program, 5);
+
+    TEST_ASSERT_EQUAL_HEX8(0x40, chip8.V[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x3E, chip8.V[3]);
+    TEST_ASSERT_EQUAL(0, chip8.V[0xF]);
+
+    set_profile(&chip8, PROFILE_SCHIP_MODERN);
+    run_opcodes(program, 5);
+    TEST_ASSERT_EQUAL_HEX8(0x01, chip8.V[0]);
+}
+
+void test_should_increment_index_with_memory_quirk(void) {
+    uint16_t program[] = {0xA400, 0xF255};
+    run_opcodes(program, 2);
+    TEST_ASSERT_EQUAL_HEX(0x403, chip8.idx);
+
+    set_profile(&chip8, PROFILE_SCHIP_LEGACY);
+    run_opcodes(program, 2);
+    TEST_ASSERT_EQUAL_HEX(0x400, chip8.idx);
+}
+
+void test_should_jump_with_vx_on_schip(void) {
+    uint16_t program[] = {0x6002, 0x6304, 0xB310};
+    run_opcodes(program, 3);
+    TEST_ASSERT_EQUAL_HEX(0x312, chip8.pc);
+
+    set_profile(&chip8, PROFILE_SCHIP_LEGACY);
+    run_opcodes(program, 3);
+    TEST_ASSERT_EQUAL_HEX(0x314, chip8.pc);
+}
+
+void test_should_wrap_sprite_on_xochip(void) {
+    set_profile(&chip8, PROFILE_XOCHIP);
+    chip8.memory[0x400] = 0xFF;
+    chip8.memory[0x401] = 0xFF;
+    uint16_t program[] = {0xA400, 0x603C, 0x611F, 0xD012};
+    run_opcodes(program, 4);
+
+    TEST_ASSERT_TRUE(get_pixel(chip8.display[0], 63, 31));
+    TEST_ASSERT_TRUE(get_pixel(chip8.display[0], 3, 31));
+    TEST_ASSERT_TRUE(get_pixel(chip8.display[0], 60, 0));
+    TEST_ASSERT_TRUE(get_pixel(chip8.display[0], 0, 0));
+    TEST_ASSERT_FALSE(get_pixel(chip8.display[0], 4, 0));
+}
+
+void test_should_hash_with_sha1(void) {
+    uint8_t digest[SHA1_SIZE];
+    uint8_t expected[SHA1_SIZE] = {0xA9, 0x99, 0x3E, 0x36, 0x47, 0x06, 0x81,
+                                   0x6A, 0xBA, 0x3E, 0x25, 0x71, 0x78, 0x50,
+                                   0xC2, 0x6C, 0x9C, 0xD0, 0xD8, 0x9D};
+    sha1((const uint8_t *)"abc", 3, digest);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, digest, SHA1_SIZE);
+}
+
+void test_should_look_up_rom_settings(void) {
+    struct {
+        romdb_header_t header;
+        rom_record_t records[3];
+    } db;
+    memset(&db, 0, sizeof(db));
+    memcpy(db.header.magic, ROMDB_MAGIC, sizeof(db.header.magic));
+    db.header.version = ROMDB_VERSION;
+    db.header.record_size = sizeof(rom_record_t);
+    for (int i = 0; i < 3; i++) {
+        db.records[i].sha1[0] = 0x10 * (i + 1);
+        db.records[i].display_wait = -1;
+    }
+    db.records[1].profile = PROFILE_XOCHIP;
+    db.records[1].ipf[1] = 0x01;
+    db.records[1].keymap[5] = SDLK_k;
+
+    rom_info_t info;
+    uint8_t digest[SHA1_SIZE] = {0x20};
+    TEST_ASSERT_TRUE(
+        lookup_rom((const uint8_t *)&db, sizeof(db), digest, &info));
+    digest[0] = 0x25;
+    TEST_ASSERT_FALSE(
+        lookup_rom((const uint8_t *)&db, sizeof(db), digest, &info));
+
+    apply_rom_info(&chip8, &info);
+    TEST_ASSERT_EQUAL(PROFILE_XOCHIP, chip8.profile);
+    TEST_ASSERT_EQUAL(256, chip8.ipf);
+    TEST_ASSERT_EQUAL(SDLK_k, chip8.sdl.keymap[5]);
+    TEST_ASSERT_EQUAL(SDLK_x, chip8.sdl.keymap[0]);
+}
+
+// Number of lit pixels on plane 1
+static int count_pixels(void) {
+    int lit = 0;
+    for (int y = 0; y < DISPLAY_MAX_HEIGHT; y++) {
+        for (int x = 0; x < DISPLAY_MAX_WIDTH; x++) {
+            lit += get_pixel(chip8.display[0], x, y);
+        }
+    }
+    return lit;
+}
+
+void test_should_clip_sprite_at_largest_coordinates(void) {
+    memset(&chip8.memory[0x400], 0xFF, 15);
+    uint16_t program[] = {0xA400, 0x60FF, 0x61FF, 0xD01F};
+    run_opcodes(program, 4);
+
+    // (255, 255) wraps to (63, 31), leaving one pixel on screen
+    TEST_ASSERT_TRUE(get_pixel(chip8.display[0], 63, 31));
+    TEST_ASSERT_EQUAL(1, count_pixels());
+    TEST_ASSERT_EACH_EQUAL_UINT8(false, chip8.keypad, sizeof(chip8.keypad));
+    TEST_ASSERT_EACH_EQUAL_UINT8(0, chip8.rpl, sizeof(chip8.rpl));
+}
+
+void test_should_wrap_16x16_sprite_at_largest_coordinates(void) {
+    set_profile(&chip8, PROFILE_XOCHIP);
+    memset(&chip8.memory[0x400], 0xFF, 32);
+    uint16_t program[] = {0x00FF, 0xA400, 0x60FF, 0x61FF, 0xD010};
+    run_opcodes(program, 5);
+
+    // (255, 255) wraps to (127, 63) and the sprite wraps to the far corner
+    TEST_ASSERT_TRUE(get_pixel(chip8.display[0], 127, 63));
+    TEST_ASSERT_TRUE(get_pixel(chip8.display[0], 14, 14));
+    TEST_ASSERT_FALSE(get_pixel(chip8.display[0], 15, 14));
+    TEST_ASSERT_EQUAL(256, count_pixels());
+    TEST_ASSERT_EACH_EQUAL_UINT8(false, chip8.keypad, sizeof(chip8.keypad));
+}
+
+void test_should_restore_saved_state(void) {
+    static uint8_t state[SAVESTATE_SIZE];
+    uint16_t program[] = {0x6042, 0xA400, 0xF055};
+    run_opcodes(program, 3);
+    TEST_ASSERT_EQUAL(SAVESTATE_SIZE,
+                      chip8_save_state(&chip8, state, sizeof(state)));
+
+    uint16_t random[] = {0xC1FF};
+    run_opcodes(random, 1);
+    uint8_t first = chip8.V[1];
+    chip8.V[0] = 0;
+    chip8.memory[0x400] = 0;
+    chip8.sdl.scale = 7;
+    TEST_ASSERT_TRUE(chip8_load_state(&chip8, state, sizeof(state)));
+
+    TEST_ASSERT_EQUAL_HEX8(0x42, chip8.V[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x42, chip8.memory[0x400]);
+    TEST_ASSERT_EQUAL(7, chip8.sdl.scale);
+
+    // The generator is restored too, so the same number follows
+    run_opcodes(random, 1);
+    TEST_ASSERT_EQUAL(first, chip8.V[1]);
+}
+
+void test_should_reject_incompatible_state(void) {
+    static uint8_t state[SAVESTATE_SIZE];
+    TEST_ASSERT_EQUAL(0, chip8_save_state(&chip8, state, sizeof(state) - 1));
+    chip8_save_state(&chip8, state, sizeof(state));
+
+    TEST_ASSERT_FALSE(chip8_load_state(&chip8, state, sizeof(state) - 1));
+    state[4] = SAVESTATE_VERSION + 1;
+    TEST_ASSERT_FALSE(chip8_load_state(&chip8, state, sizeof(state)));
+}
+
+// Save the current state with one field overwritten, then try to load it
+// back over an instance whose V3 has changed since
+#define LOAD_WITH_FIELD(field, type, value)                              \
+    do {                                                                 \
+        static uint8_t state[SAVESTATE_SIZE];                            \
+        type patched = (value);                                          \
+        chip8.V[3] = 0x11;                                               \
+        chip8_save_state(&chip8, state, sizeof(state));                  \
+        memcpy(&state[sizeof(savestate_header_t) +                       \
+                      offsetof(chip8_t, field)],                         \
+               &patched, sizeof(patched));                               \
+        chip8.V[3] = 0x33;                                               \
+        loaded = chip8_load_state(&chip8, state, sizeof(state));         \
+    } while (0)
+
+void test_should_reject_corrupt_state(void) {
+    bool loaded;
+    LOAD_WITH_FIELD(sp, uint16_t, 17);
+    TEST_ASSERT_FALSE(loaded);
+    LOAD_WITH_FIELD(profile, profile_t, PROFILE_COUNT);
+    TEST_ASSERT_FALSE(loaded);
+    LOAD_WITH_FIELD(display_width, uint16_t, HIRES_WIDTH);  // Still lores
+    TEST_ASSERT_FALSE(loaded);
+    LOAD_WITH_FIELD(planes, uint8_t, 4);
+    TEST_ASSERT_FALSE(loaded);
+    LOAD_WITH_FIELD(ipf, int, 0);
+    TEST_ASSERT_FALSE(loaded);
+
+    // Nothing of a refused state is restored
+    TEST_ASSERT_EQUAL_HEX8(0x33, chip8.V[3]);
+
+    LOAD_WITH_FIELD(sp, uint16_t, 16);
+    TEST_ASSERT_TRUE(loaded);
+    TEST_ASSERT_EQUAL_HEX8(0x11, chip8.V[3]);
+}
+
+void test_should_clone_emulation_state(void) {
+    static chip8_t clone;
+    initialize(&clone);
+    write_memory(&clone, 0x8000, 0x77);  // Must not survive the clone
+    clone.sdl.scale = 3;
+
+    write_memory(&chip8, 0x300, 0x12);
+    chip8.V[5] = 0x55;
+    chip8_clone(&clone, &chip8);
+    TEST_ASSERT_EQUAL_HEX8(0x12, clone.memory[0x300]);
+    TEST_ASSERT_EQUAL_HEX8(0x00, clone.memory[0x8000]);
+    TEST_ASSERT_EQUAL_HEX8(0x55, clone.V[5]);
+    TEST_ASSERT_EQUAL(3, clone.sdl.scale);
+
+    // A later clone picks up pages written since
+    write_memory(&chip8, 0x9000, 0x34);
+    chip8_clone(&clone, &chip8);
+    TEST_ASSERT_EQUAL_MEMORY(chip8.memory, clone.memory, MEMORY_SIZE);
+
+    // Cloning leaves the source alone; preparing it drops pages of zeros
+    write_memory(&chip8, 0x9000, 0x00);
+    uint64_t used[MEMORY_PAGES / 64];
+    memcpy(used, chip8.dirty[DIRTY_CLONE], sizeof(used));
+    chip8_clone(&clone, &chip8);
+    TEST_ASSERT_EQUAL_MEMORY(used, chip8.dirty[DIRTY_CLONE], sizeof(used));
+    chip8_clone_prepare(&chip8);
+    int zeros = 0x9000 / MEMORY_PAGE_SIZE;
+    TEST_ASSERT_FALSE(is_page_dirty(&chip8, DIRTY_CLONE, zeros));
+    TEST_ASSERT_TRUE(
+        is_page_dirty(&chip8, DIRTY_CLONE, 0x300 / MEMORY_PAGE_SIZE));
+    chip8_clone(&clone, &chip8);
+    TEST_ASSERT_EQUAL_MEMORY(chip8.memory, clone.memory, MEMORY_SIZE);
+}
+
+void test_should_keep_save_slots_across_opens(void) {
+    const char *slots_path = "./tests/test_roms/test_slots.sav";
+    save_slots_t *slots = slots_open(slots_path);
+    TEST_ASSERT_NOT_NULL(slots);
+    TEST_ASSERT_FALSE(slots_load(slots, 0, &chip8));
+
+    // The file only appears with the first save
+    FILE *fp = fopen(slots_path, "rb");
+    TEST_ASSERT_NULL(fp);
+
+    // Saving twice flips between the slot's copies; the newest one loads
+    chip8.V[1] = 0x11;
+    TEST_ASSERT_TRUE(slots_save(slots, 2, &chip8));
+    chip8.V[1] = 0x22;
+    TEST_ASSERT_TRUE(slots_save(slots, 2, &chip8));
+    chip8.V[1] = 0x33;
+    TEST_ASSERT_TRUE(slots_load(slots, 2, &chip8));
+    TEST_ASSERT_EQUAL_HEX8(0x22, chip8.V[1]);
+    TEST_ASSERT_FALSE(slots_load(slots, 0, &chip8));
+    slots_close(slots);
+
+    chip8.V[1] = 0x44;
+    slots = slots_open(slots_path);
+    TEST_ASSERT_NOT_NULL(slots);
+    TEST_ASSERT_TRUE(slots_load(slots, 2, &chip8));
+    TEST_ASSERT_EQUAL_HEX8(0x22, chip8.V[1]);
+    slots_close(slots);
+
+    // A torn live copy is passed over for the save before it
+    fp = fopen(slots_path, "r+b");
+    TEST_ASSERT_NOT_NULL(fp);
+    long live = sizeof(saveslots_header_t) + (2 * 2 + 1) * SAVESTATE_SIZE;
+    fseek(fp, live + SAVESTATE_SIZE / 2, SEEK_SET);
+    fputc(0x5A, fp);
+    fclose(fp);
+    slots = slots_open(slots_path);
+    TEST_ASSERT_NOT_NULL(slots);
+    TEST_ASSERT_TRUE(slots_load(slots, 2, &chip8));
+    TEST_ASSERT_EQUAL_HEX8(0x11, chip8.V[1]);
+    slots_close(slots);
+    remove(slots_path);
+}
+
+void test_should_rewind_frame_by_frame(void) {
+    rewind_buffer_t *history = rewind_open(1, 1024 * 1024);
+    TEST_ASSERT_NOT_NULL(history);
+
+    // One register and one memory byte change per frame
+    for (int frame = 0; frame < 5; frame++) {
+        chip8.V[0] = frame;
+        write_memory(&chip8, 0x400 + frame, 0xA0 + frame);
+        rewind_push(history, &chip8);
+    }
+    TEST_ASSERT_EQUAL(4, rewind_frames(history));
+
+    chip8.keypad[3] = true;
+    TEST_ASSERT_TRUE(rewind_pop(history, &chip8));
+    TEST_ASSERT_EQUAL(3, chip8.V[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x00, chip8.memory[0x404]);
+    TEST_ASSERT_EQUAL_HEX8(0xA3, chip8.memory[0x403]);
+    TEST_ASSERT_TRUE(chip8.keypad[3]);
+
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_TRUE(rewind_pop(history, &chip8));
+    }
+    TEST_ASSERT_EQUAL(0, chip8.V[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x00, chip8.memory[0x401]);
+    TEST_ASSERT_FALSE(rewind_pop(history, &chip8));
+
+    rewind_close(history);
+}
+
+void test_should_drop_oldest_rewind_frames_over_budget(void) {
+    rewind_buffer_t *history = rewind_open(1, 64);
+    for (int frame = 0; frame < 40; frame++) {
+        chip8.V[frame % 16] = frame;
+        write_memory(&chip8, 0x400 + frame * 8, frame);
+        rewind_push(history, &chip8);
+    }
+
+    // Only the newest deltas fit, and they still rewind correctly
+    int held = rewind_frames(history);
+    TEST_ASSERT_TRUE(held > 0 && held < 39);
+    for (int i = 0; i < held; i++) {
+        TEST_ASSERT_TRUE(rewind_pop(history, &chip8));
+    }
+    TEST_ASSERT_EQUAL_HEX8(39 - held, chip8.memory[0x400 + (39 - held) * 8]);
+    TEST_ASSERT_EQUAL_HEX8(0, chip8.memory[0x400 + (40 - held) * 8]);
+
+    rewind_close(history);
+}
+
+void test_should_track_dirty_memory_pages(void) {
+    uint16_t program[] = {0xF055};
+    clear_dirty_pages(&chip8, DIRTY_REWIND);
+    clear_dirty_pages(&chip8, DIRTY_HASH);
+    chip8.idx = 0x520;
+    chip8.V[0] = 0xAB;
+    run_opcodes(program, 1);
+
+    TEST_ASSERT_EQUAL_HEX8(0xAB, chip8.memory[0x520]);
+    int page = 0x520 / MEMORY_PAGE_SIZE;
+    TEST_ASSERT_TRUE(is_page_dirty(&chip8, DIRTY_REWIND, page));
+    TEST_ASSERT_FALSE(is_page_dirty(&chip8, DIRTY_REWIND, page + 1));
+
+    // Each user clears only its own view
+    clear_dirty_pages(&chip8, DIRTY_REWIND);
+    TEST_ASSERT_FALSE(is_page_dirty(&chip8, DIRTY_REWIND, page));
+    TEST_ASSERT_TRUE(is_page_dirty(&chip8, DIRTY_HASH, page));
+}
+
+void test_should_hash_state_incrementally(void) {
+    static state_hash_t hash, fresh;
+    init_state_hash(&hash, &chip8);
+    uint64_t before = hash_state(&hash, &chip8);
+
+    write_memory(&chip8, 0x900, 0x55);
+    uint64_t after = hash_state(&hash, &chip8);
+    TEST_ASSERT_TRUE(before != after);
+
+    // Only the written page was rehashed, yet the result matches a full hash
+    init_state_hash(&fresh, &chip8);
+    TEST_ASSERT_TRUE(after == hash_state(&fresh, &chip8));
+
+    write_memory(&chip8, 0x900, 0x00);
+    TEST_ASSERT_TRUE(before == hash_state(&hash, &chip8));
+    chip8.V[2] = 1;
+    TEST_ASSERT_TRUE(before != hash_state(&hash, &chip8));
+}
+
+// Run both peers of a session on localhost until each has run `frames`
+// frames. Each presses its own key on frames where `presses` is set, and
+// one that is done keeps serving the other.
+static void run_peers(netplay_t *nets[2], chip8_t *peers[2], int frames,
+                      const uint8_t *presses) {
+    int done[2] = {0, 0};
+    for (int wait = 0; wait < 20000 && (done[0] < frames || done[1] < frames);
+         wait++) {
+        for (int i = 0; i < 2; i++) {
+            if (done[i] == frames) {
+                netplay_poll(nets[i]);
+                continue;
+            }
+            peers[i]->keypad[i] = presses[done[i]] >> i & 1;
+            if (netplay_frame(nets[i], peers[i])) {
+                tick_timers(peers[i]);
+                done[i]++;
+            }
+        }
+        SDL_Delay(1);
+    }
+    TEST_ASSERT_EQUAL(frames, done[0]);
+    TEST_ASSERT_EQUAL(frames, done[1]);
+}
+
+void test_should_agree_on_state_over_lossy_netplay(void) {
+    // Counts frames with key 0 held into V2, and mixes in a random number
+    // whenever key 1 is held, storing both into memory
+    uint16_t program[] = {0x6101, 0xE09E, 0x1208, 0x7201, 0xE19E, 0x120E,
+                          0xC3FF, 0x8324, 0xA400, 0xF355, 0x1202};
+    static chip8_t peer;
+    initialize(&peer);
+    for (size_t i = 0; i < sizeof(program) / sizeof(program[0]); i++) {
+        chip8.memory[PC_START + i * 2] = program[i] >> 8;
+        chip8.memory[PC_START + i * 2 + 1] = program[i] & 0xFF;
+    }
+    memcpy(peer.memory, chip8.memory, sizeof(chip8.memory));
+    seed_rng(&peer, 1234);
+
+    // The peers drop a fifth of their packets and delay the rest
+    netplay_faults_t faults = {.delay_ms = 20, .loss = 20};
+    const uint8_t *rom = &chip8.memory[PC_START];
+    netplay_t *nets[2] = {
+        netplay_open(47811, "127.0.0.1:47812", &chip8, rom, 22, &faults),
+        netplay_open(47812, "127.0.0.1:47811", &peer, rom, 22, &faults)};
+    TEST_ASSERT_NOT_NULL(nets[0]);
+    TEST_ASSERT_NOT_NULL(nets[1]);
+
+    // Input changes often at first, then not at all, so the last frames are
+    // predicted correctly and both peers end in the same state
+    uint8_t presses[200] = {0};
+    for (int frame = 0; frame < 150; frame++) {
+        presses[frame] = (frame * 7 / 5 + frame / 3) & 3;
+    }
+    chip8_t *peers[2] = {&chip8, &peer};
+    run_peers(nets, peers, 200, presses);
+
+    static state_hash_t hashes[2];
+    init_state_hash(&hashes[0], &chip8);
+    init_state_hash(&hashes[1], &peer);
+    TEST_ASSERT_TRUE(hash_state(&hashes[0], &chip8) ==
+                     hash_state(&hashes[1], &peer));
+    TEST_ASSERT_TRUE(chip8.V[2] > 0);
+    TEST_ASSERT_TRUE(netplay_rollbacks(nets[0]) + netplay_rollbacks(nets[1]) >
+                     0);
+
+    netplay_close(nets[0]);
+    netplay_close(nets[1]);
+}
+
+void test_should_replay_recorded_movie(void) {
+    const char *movie_path = "./tests/test_roms/test_movie.c8m";
+    uint8_t rom[] = {0x60, 0x01, 0xC0, 0xFF};
+    set_profile(&chip8, PROFILE_SCHIP_MODERN);
+    seed_rng(&chip8, 99);
+
+    movie_t *movie = movie_record(movie_path, &chip8, rom, sizeof(rom));
+    TEST_ASSERT_NOT_NULL(movie);
+    bool presses[5] = {false, true, true, false, true};
+    for (int frame = 0; frame < 5; frame++) {
+        chip8.keypad[0xA] = presses[frame];
+        TEST_ASSERT_TRUE(movie_frame(movie, &chip8));
+    }
+    movie_close(movie);
+
+    initialize(&chip8);
+    movie = movie_replay(movie_path, &chip8, rom, sizeof(rom));
+    TEST_ASSERT_NOT_NULL(movie);
+    TEST_ASSERT_EQUAL(PROFILE_SCHIP_MODERN, chip8.profile);
+    TEST_ASSERT_EQUAL(99, chip8.rng);
+    for (int frame = 0; frame < 5; frame++) {
+        TEST_ASSERT_TRUE(movie_frame(movie, &chip8));
+        TEST_ASSERT_EQUAL(presses[frame], chip8.keypad[0xA]);
+    }
+    TEST_ASSERT_FALSE(movie_frame(movie, &chip8));
+    movie_close(movie);
+
+    // A movie only replays against the ROM it was recorded with
+    rom[3] = 0x0F;
+    TEST_ASSERT_NULL(movie_replay(movie_path, &chip8, rom, sizeof(rom)));
+    rom[3] = 0xFF;
+
+    // Settings no run could have had are refused
+    FILE *fp = fopen(movie_path, "r+b");
+    TEST_ASSERT_NOT_NULL(fp);
+    uint8_t no_ipf[2] = {0, 0};
+    fseek(fp, offsetof(movie_header_t, ipf), SEEK_SET);
+    fwrite(no_ipf, sizeof(no_ipf), 1, fp);
+    fclose(fp);
+    TEST_ASSERT_NULL(movie_replay(movie_path, &chip8, rom, sizeof(rom)));
+    remove(movie_path);
+}
+
+void test_should_tick_timers_without_audio(void) {
+    chip8.delay_timer = 2;
+    chip8.sound_timer = 2;
+    tick_timers(&chip8);
+
+    TEST_ASSERT_EQUAL(1, chip8.delay_timer);
+    TEST_ASSERT_EQUAL(1, chip8.sound_timer);
+    TEST_ASSERT_FALSE(swap_front(&chip8.sdl.audio.slots));
+}
+
+void test_should_reject_unsafe_capture_patterns(void) {
+    const char *paths[] = {"frames.ppm", "frame_%s.ppm", "%d_%d.ppm",
+                           "frame_%n.ppm", "frame_%05ld.ppm", "100%.ppm"};
+    for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); i++)
+        TEST_ASSERT_NULL(capture_open(paths[i], 1, true, 64, 32));
+
+    capture_t *capture = capture_open("frame_%05d_100%%.ppm", 1, true, 64, 32);
+    TEST_ASSERT_NOT_NULL(capture);
+    capture_close(capture);
+}
+
 // Change 'main' to 'SDL_main' to avoid conflict with SDL2's entry point
 int SDL_main(int argc, char *argv[]) {
     // To avoid unused parameter warnings
@@ -96,5 +1040,53 @@ int SDL_main(int argc, char *argv[]) {
     RUN_TEST(test_should_fail_on_invalid_rom_path);
     RUN_TEST(test_should_setup_sdl);
     RUN_TEST(test_should_cleanup_sdl);
+    RUN_TEST(test_should_hand_input_from_events_to_emulator);
+    RUN_TEST(test_should_bound_fade_length);
+    RUN_TEST(test_should_hand_over_newest_frame);
+    RUN_TEST(test_should_end_frame_on_draw_with_display_wait);
+    RUN_TEST(test_should_run_full_budget_without_display_wait);
+    RUN_TEST(test_should_parse_profile_names);
+    RUN_TEST(test_should_switch_to_hires);
+    RUN_TEST(test_should_ignore_schip_opcodes_on_vip);
+    RUN_TEST(test_should_draw_16x16_sprite_in_hires);
+    RUN_TEST(test_should_clip_sprite_at_bottom_right);
+    RUN_TEST(test_should_scroll_display);
+    RUN_TEST(test_should_scroll_lores_by_profile);
+    RUN_TEST(test_should_draw_lores_dxy0_by_profile);
+    RUN_TEST(test_should_save_and_load_rpl_flags);
+    RUN_TEST(test_should_point_to_big_font);
+    RUN_TEST(test_should_load_long_index);
+    RUN_TEST(test_should_skip_over_long_index);
+    RUN_TEST(test_should_save_and_load_register_range);
+    RUN_TEST(test_should_draw_to_selected_planes);
+    RUN_TEST(test_should_scroll_up);
+    RUN_TEST(test_should_read_sprite_across_end_of_memory);
+    RUN_TEST(test_should_load_audio_pattern_and_pitch);
+    RUN_TEST(test_should_render_audio_while_sound_timer_runs);
+    RUN_TEST(test_should_start_sound_on_the_instruction_that_sets_it);
+    RUN_TEST(test_should_steer_audio_lead_towards_target);
+    RUN_TEST(test_should_render_headless_audio_to_wav);
+    RUN_TEST(test_should_open_audio_once_sound_first_plays);
+    RUN_TEST(test_should_shift_vy_without_shift_quirk);
+    RUN_TEST(test_should_increment_index_with_memory_quirk);
+    RUN_TEST(test_should_jump_with_vx_on_schip);
+    RUN_TEST(test_should_wrap_sprite_on_xochip);
+    RUN_TEST(test_should_hash_with_sha1);
+    RUN_TEST(test_should_look_up_rom_settings);
+    RUN_TEST(test_should_clip_sprite_at_largest_coordinates);
+    RUN_TEST(test_should_wrap_16x16_sprite_at_largest_coordinates);
+    RUN_TEST(test_should_restore_saved_state);
+    RUN_TEST(test_should_reject_incompatible_state);
+    RUN_TEST(test_should_reject_corrupt_state);
+    RUN_TEST(test_should_clone_emulation_state);
+    RUN_TEST(test_should_keep_save_slots_across_opens);
+    RUN_TEST(test_should_rewind_frame_by_frame);
+    RUN_TEST(test_should_drop_oldest_rewind_frames_over_budget);
+    RUN_TEST(test_should_track_dirty_memory_pages);
+    RUN_TEST(test_should_hash_state_incrementally);
+    RUN_TEST(test_should_agree_on_state_over_lossy_netplay);
+    RUN_TEST(test_should_replay_recorded_movie);
+    RUN_TEST(test_should_tick_timers_without_audio);
+    RUN_TEST(test_should_reject_unsafe_capture_patterns);
     return UNITY_END();
 }
\ No newline at end of file